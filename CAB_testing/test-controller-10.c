@@ -0,0 +1,174 @@
+#include "shared.h"
+
+// Tester for controller (--batch: calls held for a window and assigned together)
+
+/*
+    Alpha  Beta
+ 10 |   |  -----
+  . |   |  |   |
+  1 -----  |   |
+
+  With --batch 200, calls are answered when the 200ms window that the
+  first of them opened closes. Two calls in one window, 5 to 8 and 3 to 6,
+  would both go to Alpha one at a time. Assigned together, 3 to 6 (which
+  only Alpha serves well) gets Alpha and 5 to 8 goes to Beta, and each car
+  gets one FLOOR.
+*/
+
+#define DELAY 50000   // 50ms
+#define WINDOW_MS 200
+
+pid_t controller(void);
+int connect_to_controller(void);
+void frame(char *, size_t *, const char *);
+void test_reply(int, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 10 10");
+  usleep(DELAY);
+
+  int pad = connect_to_controller();
+  send_message(pad, "SESSION");
+  test_reply(pad, "SESSION OK");
+
+  // Both calls in one write, so in one window
+  char calls[64];
+  size_t calls_len = 0;
+  frame(calls, &calls_len, "CALL 1 5 8");
+  frame(calls, &calls_len, "CALL 2 3 6");
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  send_looped(pad, calls, calls_len);
+  test_reply(pad, "CAR 1 Beta");
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  test_reply(pad, "CAR 2 Alpha");
+
+  msg("Held for the window");
+  long waited_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+  if (waited_ms >= WINDOW_MS * 3 / 4)
+    printf("Held for the window\n");
+  else
+    printf("Answered after %ldms\n", waited_ms);
+
+  // One FLOOR each, for the first stop of the whole plan
+  test_recv(alpha, "FLOOR 3");
+  test_recv(beta, "FLOOR 5");
+
+  // A one-shot call gets its reply, then the controller hangs up
+  int fd = connect_to_controller();
+  send_message(fd, "CALL 2 1");
+  test_reply(fd, "CAR Alpha");
+  msg("Closed after reply");
+  char byte;
+  if (recv(fd, &byte, 1, 0) == 0)
+    printf("Closed after reply\n");
+  else
+    printf("Still open\n");
+  close(fd);
+
+  // A pad that hangs up before its window closes must not upset the controller
+  fd = connect_to_controller();
+  send_message(fd, "CALL 4 2");
+  close(fd);
+  fd = connect_to_controller();
+  send_message(fd, "CALL 9 10");
+  msg("Answered after a pad hung up");
+  char *reply = receive_msg(fd);
+  if (strncmp(reply, "CAR ", 4) == 0)
+    printf("Answered after a pad hung up\n");
+  else
+    printf("%s\n", reply);
+  free(reply);
+  close(fd);
+
+  cleanup(p);
+
+  close(pad);
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+// frame: append one length-prefixed message to buf
+void frame(char *buf, size_t *len, const char *text)
+{
+  uint16_t nlen = htons(strlen(text));
+  memcpy(buf + *len, &nlen, sizeof(nlen));
+  memcpy(buf + *len + sizeof(nlen), text, strlen(text));
+  *len += sizeof(nlen) + strlen(text);
+}
+
+void test_reply(int fd, const char *expected)
+{
+  msg(expected);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+}
+
+void test_recv(int fd, const char *expected)
+{
+  struct timeval tv = {2, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  msg(expected);
+  uint16_t nlen;
+  char buf[64];
+  if (recv(fd, &nlen, sizeof(nlen), MSG_WAITALL) != sizeof(nlen) ||
+      ntohs(nlen) >= sizeof(buf) ||
+      recv(fd, buf, ntohs(nlen), MSG_WAITALL) != ntohs(nlen))
+  {
+    printf("(nothing)\n");
+    return;
+  }
+  buf[ntohs(nlen)] = '\0';
+  printf("%s\n", buf);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--batch", "200", NULL);
+  }
+
+  return pid;
+}
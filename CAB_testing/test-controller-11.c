@@ -0,0 +1,106 @@
+#include "shared.h"
+
+// Tester for controller (--group: passengers grouped by destination)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  5 |   |  -----
+  1 -----  |   |
+
+  Three passengers call from the lobby. The first, to 2, goes to Alpha,
+  which is waiting there. The second is going to 10: Alpha would get
+  them there soonest, but it would add a stop far from Alpha's others, so
+  with destination grouping it goes to Beta instead. The third, to 3, is
+  close to Alpha's stop at 2 and rides with Alpha.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 5 5");
+  usleep(DELAY);
+
+  test_call("CALL 1 2", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 1");
+  test_call("CALL 1 10", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 1");
+  test_call("CALL 1 3", "CAR Alpha");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--group", NULL);
+  }
+
+  return pid;
+}
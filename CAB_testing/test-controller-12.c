@@ -0,0 +1,120 @@
+#include "shared.h"
+
+// Tester for controller (--zones: cars kept to sectors of the building by demand)
+
+/*
+    Alpha  Beta   Gamma
+ 10 |   |  -----
+  . |   |  |   |
+  3 |   |  |   |  |   |
+  1 -----  |   |  -----
+
+  Zones are set on the first call. Until then each car's zone is its whole
+  range. The first call, 1 to 2, goes to Alpha and puts the demand low,
+  so Alpha gets the bottom sector and Beta the top one. Alpha is the
+  quickest to take 2 to 9 as well, but that is outside its zone while it
+  is busy, so Beta comes down for it. Gamma then joins, serving only 1 to
+  3: the next call rebalances into three sectors, and Gamma, which can't
+  serve any of them whole, is zoned to the part of the bottom one in its
+  range. Nobody can be spared for the top floor, so Beta takes it on.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_request(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 10 10");
+  usleep(DELAY);
+
+  test_request("ZONES", "ZONES Alpha=1-10 Beta=1-10");
+  test_request("CALL 1 2", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 1");
+  test_request("ZONES", "ZONES Alpha=1-6 Beta=7-10");
+  test_request("CALL 2 9", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 2");
+
+  int gamma = connect_to_controller();
+  send_message(gamma, "CAR Gamma 1 3");
+  send_message(gamma, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  test_request("CALL 1 3", "CAR Gamma");
+  test_request("ZONES", "ZONES Alpha=1-5 Beta=6-10 Gamma=1-3");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+  close(gamma);
+
+  printf("\nTests completed.\n");
+}
+
+void test_request(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--zones", NULL);
+  }
+
+  return pid;
+}
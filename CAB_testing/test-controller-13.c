@@ -0,0 +1,155 @@
+#include "shared.h"
+
+// Tester for controller (--adaptive: dispatch policy follows the traffic pattern)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  . |   |  |   |
+  1 -----  -----
+
+  Traffic starts out light. A burst of calls from the lobby is an up-peak,
+  confirmed on the second look (every 8 calls, once 16 have come in). Then
+  calls all head back down to the lobby: while the window still holds the
+  up-peak calls the traffic looks two-way, and once they have mostly aged
+  out it is a down-peak. Each switch changes the dispatch policy and goes
+  in the history.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_call(const char *, const char *);
+void test_traffic(const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  test_traffic("pattern=light dispatch=group+zones switches=0 history=none");
+
+  char call[32];
+  for (int i = 0; i < 24; i++)
+  {
+    sprintf(call, "CALL 1 %d", 2 + i % 9);
+    test_call(call, NULL);
+  }
+  test_traffic("pattern=up-peak dispatch=group+zones switches=1 history=up-peak");
+
+  for (int i = 0; i < 48; i++)
+  {
+    sprintf(call, "CALL %d 1", 2 + i % 9);
+    test_call(call, NULL);
+  }
+  test_traffic("pattern=down-peak dispatch=eta switches=3 history=up-peak,two-way,down-peak");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+// test_call: make a call; with no expected reply, only check that a car took it
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  char *reply = receive_msg(fd);
+  if (expectedreply != NULL)
+  {
+    msg(expectedreply);
+    printf("%s\n", reply);
+  }
+  else if (strncmp(reply, "CAR ", 4) != 0)
+  {
+    printf("%s: %s\n", sendmsg, reply);
+  }
+  free(reply);
+  close(fd);
+}
+
+// test_traffic: the pattern, policy and switch history from TRAFFIC, leaving out the
+// figures and times that vary from run to run
+void test_traffic(const char *expected)
+{
+  int fd = connect_to_controller();
+  send_message(fd, "TRAFFIC");
+  msg(expected);
+  char *reply = receive_msg(fd);
+
+  char pattern[32] = "", dispatch[32] = "", history[256] = "";
+  int switches = -1;
+  char *field;
+  if ((field = strstr(reply, "pattern=")) != NULL)
+    sscanf(field, "pattern=%31s dispatch=%31s", pattern, dispatch);
+  if ((field = strstr(reply, "switches=")) != NULL)
+    sscanf(field, "switches=%d", &switches);
+  if ((field = strstr(reply, "history=")) != NULL)
+  {
+    // Keep the pattern names, drop each "@-<seconds>s"
+    size_t len = 0;
+    for (char *c = field + 8; *c != '\0' && len < sizeof(history) - 1; c++)
+    {
+      if (*c == '@')
+      {
+        while (c[1] != '\0' && c[1] != ',')
+          c++;
+        continue;
+      }
+      history[len++] = *c;
+    }
+    history[len] = '\0';
+  }
+  printf("pattern=%s dispatch=%s switches=%d history=%s\n", pattern, dispatch, switches, history);
+  free(reply);
+  close(fd);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--adaptive", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,117 @@
+#include "shared.h"
+
+// Tester for controller (--park: idle cars wait where calls are expected)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  8 |   |  |   |
+  2 |   |  |   |
+  1 -----  -----
+
+  Alpha takes a passenger from 8 to 9. With its stops done and its doors
+  closed, it is sent back to 8, where the only call so far came from.
+  Beta takes a passenger from 2 to 4, and when it is idle it parks at 2:
+  8 is covered by Alpha already, so Beta spreads out to the other floor
+  calls come from.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  test_call("CALL 8 9", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 8");
+  send_message(alpha, "STATUS Opening 8 8");
+  test_recv(alpha, "RECV: FLOOR 9");
+  send_message(alpha, "STATUS Opening 9 9");
+  send_message(alpha, "STATUS Closed 9 9");
+  test_recv(alpha, "RECV: FLOOR 8");
+
+  test_call("CALL 2 4", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 2");
+  send_message(beta, "STATUS Opening 2 2");
+  test_recv(beta, "RECV: FLOOR 4");
+  send_message(beta, "STATUS Opening 4 4");
+  send_message(beta, "STATUS Closed 4 4");
+  test_recv(beta, "RECV: FLOOR 2");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--park", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,136 @@
+#include "shared.h"
+
+// Tester for controller (calls handed on when a car leaves service)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  . |   |  |   |
+  1 -----  -----
+
+  Alpha, on its own, takes a passenger at 3 for 5 and then a call from 7
+  to 9. Beta joins, and Alpha goes into emergency mode. The passenger on
+  board gets out at 3, where Alpha stopped, so Beta collects them there
+  and takes them to 5, then carries on for the one waiting at 7. Calls
+  after that all go to Beta, and STATS counts the two calls moved.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_request(const char *, const char *);
+void test_recv(int, const char *);
+void test_stats(const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  test_request("CALL 3 5", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 3");
+  send_message(alpha, "STATUS Opening 3 3");
+  test_recv(alpha, "RECV: FLOOR 5");
+  test_request("CALL 7 9", "CAR Alpha");
+
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  send_message(alpha, "EMERGENCY");
+  test_recv(beta, "RECV: FLOOR 3");
+  send_message(beta, "STATUS Opening 3 3");
+  test_recv(beta, "RECV: FLOOR 5");
+  send_message(beta, "STATUS Opening 5 5");
+  test_recv(beta, "RECV: FLOOR 7");
+
+  test_request("CALL 2 4", "CAR Beta");
+  test_stats("POOL disabled REASSIGN cars=1 moved=2 stranded=0");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+// test_stats: the STATS reply up to the timings, which vary from run to run
+void test_stats(const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, "STATS");
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  char *timings = strstr(reply, " last_ms=");
+  if (timings != NULL)
+  {
+    *timings = '\0';
+  }
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_request(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
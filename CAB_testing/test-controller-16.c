@@ -0,0 +1,135 @@
+#include "shared.h"
+
+// Tester for controller (--coalesce: calls join a car already stopping on their floor)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  5 |   |  -----
+  1 -----
+
+  Alpha is the only car when someone at 5 calls for 8, so it is sent to 5.
+  Beta then arrives at 5 and would be the quickest for a second passenger
+  at 5 going up to 9, but they join Alpha's pickup instead: only 9 is
+  added to Alpha's route. (Alpha is sent FLOOR 5 again, as for any call
+  while it hasn't reported moving.) Once Alpha has opened at 5 the pickup
+  is over, and the next call from 5 goes through dispatch to Beta as usual.
+  When Beta leaves with that call, handing it to Alpha is not a hall call,
+  so the coalescing counts don't change.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_request(const char *, const char *);
+void test_recv(int, const char *);
+void test_stats(const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  test_request("CALL 5 8", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 5");
+
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 5 5");
+  usleep(DELAY);
+
+  test_request("CALL 5 9", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 5");
+  send_message(alpha, "STATUS Opening 5 5");
+  test_recv(alpha, "RECV: FLOOR 8");
+  send_message(alpha, "STATUS Opening 8 8");
+  test_recv(alpha, "RECV: FLOOR 9");
+
+  test_request("CALL 5 6", "CAR Beta");
+  test_stats("COALESCE calls=3 merged=1 rate=0.333");
+
+  close(beta);
+  usleep(DELAY);
+  test_stats("COALESCE calls=3 merged=1 rate=0.333");
+
+  cleanup(p);
+
+  close(alpha);
+
+  printf("\nTests completed.\n");
+}
+
+// test_stats: the coalescing part of the STATS reply
+void test_stats(const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, "STATS");
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  char *coalesce = strstr(reply, "COALESCE");
+  printf("%s\n", coalesce != NULL ? coalesce : reply);
+  free(reply);
+  close(fd);
+}
+
+void test_request(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--coalesce", NULL);
+  }
+
+  return pid;
+}
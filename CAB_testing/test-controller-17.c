@@ -0,0 +1,120 @@
+#include "shared.h"
+
+// Tester for controller (--transfers: trips in legs through transfer floors)
+
+/*
+    Base   Low    High
+ 40               |   |
+  .               |   |
+ 20        |   |  |   |
+  .        |   |  -----
+  1 |   |  -----
+ B5 -----
+
+  Low and High meet at 20, and Base and Low at 1. No car serves both 5
+  and 30, so the passenger rides Low up to 20 and changes to High. High
+  is only sent for them once Low has opened at 20, so it isn't there and
+  gone before they arrive. From B2 it takes three cars.
+  Calls one car can take are answered as usual, and nothing reaches 50.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int base = connect_to_controller();
+  send_message(base, "CAR Base B5 1");
+  send_message(base, "STATUS Closed 1 1");
+  int low = connect_to_controller();
+  send_message(low, "CAR Low 1 20");
+  send_message(low, "STATUS Closed 1 1");
+  int high = connect_to_controller();
+  send_message(high, "CAR High 20 40");
+  send_message(high, "STATUS Closed 20 20");
+  usleep(DELAY);
+
+  test_call("CALL 5 30", "CAR Low 20 High");
+  test_recv(low, "RECV: FLOOR 5");
+  send_message(low, "STATUS Opening 5 5");
+  test_recv(low, "RECV: FLOOR 20");
+  send_message(low, "STATUS Opening 20 20");
+  test_recv(high, "RECV: FLOOR 20");
+
+  test_call("CALL B2 30", "CAR Base 1 Low 20 High");
+  test_recv(base, "RECV: FLOOR B2");
+
+  test_call("CALL 2 3", "CAR Low");
+  test_call("CALL 5 50", "UNAVAILABLE");
+
+  cleanup(p);
+
+  close(base);
+  close(low);
+  close(high);
+
+  printf("\nTests completed.\n");
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", "--transfers", NULL);
+  }
+
+  return pid;
+}
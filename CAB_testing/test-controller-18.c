@@ -0,0 +1,153 @@
+#include "shared.h"
+
+// Tester for controller (LATENCY: assign, wait, ride and call handling times)
+
+/*
+    Alpha  Beta
+ 10 |   |  |   |
+  7 |   |  |   |
+  3 |   |  |   |
+  1 -----  |   |
+  9        -----
+
+  Alpha takes a call from 3 to 7: one assign and one handle time when the
+  call is answered, a wait when Alpha opens at 3 and a ride when it opens at
+  7. A call nobody can take is handled but never assigned. Times depend on
+  the machine, so only the sample counts are checked, for the fleet and for
+  each car.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_request(const char *, const char *);
+void test_recv(int, const char *);
+void test_latency(const char *, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 9 9");
+  usleep(DELAY);
+
+  test_request("CALL 3 7", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 3");
+  usleep(DELAY);
+  test_latency("LATENCY", "fleet assign n=1 wait n=0 ride n=0 handle n=1");
+
+  send_message(alpha, "STATUS Opening 3 3");
+  test_recv(alpha, "RECV: FLOOR 7");
+  send_message(alpha, "STATUS Opening 7 7");
+  usleep(DELAY);
+  test_latency("LATENCY Alpha", "Alpha assign n=1 wait n=1 ride n=1 handle n=1");
+
+  test_request("CALL 11 12", "UNAVAILABLE");
+  usleep(DELAY);
+  test_latency("LATENCY", "fleet assign n=1 wait n=1 ride n=1 handle n=2");
+  test_latency("LATENCY Beta", "Beta assign n=0 wait n=0 ride n=0 handle n=0");
+  test_latency("LATENCY Gamma", "ERROR Unknown car");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+// test_latency: who the LATENCY reply is for and its sample counts
+void test_latency(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+
+  char who[50];
+  if (sscanf(reply, "LATENCY %49s", who) != 1)
+  {
+    printf("%s\n", reply);
+  }
+  else
+  {
+    printf("%s", who);
+    const char *kinds[] = {"assign", "wait", "ride", "handle"};
+    for (int k = 0; k < 4; k++)
+    {
+      char key[16];
+      unsigned long n = 0;
+      snprintf(key, sizeof(key), " %s n=", kinds[k]);
+      char *at = strstr(reply, key);
+      if (at != NULL)
+        sscanf(at + strlen(key), "%lu", &n);
+      printf(" %s n=%lu", kinds[k], n);
+    }
+    printf("\n");
+  }
+  free(reply);
+  close(fd);
+}
+
+void test_request(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *reply = receive_msg(fd);
+  printf("RECV: %s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,168 @@
+#include "shared.h"
+
+// Tester for controller (a car that stops reading must not hold up the others)
+
+/*
+    Stalled  Beta
+  4          -----
+  3          |   |
+  2 -----    -----
+  1 -----
+
+  Stalled registers and then never reads from its socket. Every call from
+  1 to 2 makes the controller re-send FLOOR 1 to it, until its socket
+  buffers are full and the controller gives up on it. Calls and Beta's
+  FLOOR messages must still get through the whole time.
+*/
+
+#define DELAY 50000      // 50ms
+#define MILLISECOND 1000 // 1ms
+#define FLOOD_CALLS 20000
+#define REPLY_TIMEOUT 2  // Seconds before a reply counts as stuck
+
+pid_t controller(void);
+int connect_to_controller(int rcvbuf);
+int timed_call(const char *, char *, size_t);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  // Register a car on floors 1 to 2 with the smallest receive buffer it can get
+  int stalled = connect_to_controller(1);
+  send_message(stalled, "CAR Stalled 1 2");
+  send_message(stalled, "STATUS Closed 1 1");
+
+  // Register a car on floors 3 to 4 that keeps reading
+  int beta = connect_to_controller(0);
+  send_message(beta, "CAR Beta 3 4");
+  send_message(beta, "STATUS Closed 3 3");
+  usleep(DELAY);
+
+  // Flood Stalled with FLOOR messages it will never read
+  msg("All calls answered");
+  char reply[64];
+  int answered = 0;
+  for (int i = 0; i < FLOOD_CALLS; i++)
+  {
+    if (timed_call("CALL 1 2", reply, sizeof(reply)) != 0)
+      break;
+    answered++;
+  }
+  if (answered == FLOOD_CALLS)
+    printf("All calls answered\n");
+  else
+    printf("Only %d of %d calls answered\n", answered, FLOOD_CALLS);
+
+  // Stalled fell too far behind and should have been dropped
+  test_call("CALL 1 2", "UNAVAILABLE");
+
+  // Beta must still be dispatched, and told where to go, straight away
+  test_call("CALL 3 4", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 3");
+
+  cleanup(p);
+
+  close(stalled);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+// timed_call: send one call request, returning -1 if no reply arrives in time
+int timed_call(const char *sendmsg, char *reply, size_t reply_size)
+{
+  int fd = connect_to_controller(0);
+  struct timeval tv = {REPLY_TIMEOUT, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  send_message(fd, sendmsg);
+
+  uint16_t nlen;
+  if (recv(fd, &nlen, sizeof(nlen), MSG_WAITALL) != sizeof(nlen))
+  {
+    close(fd);
+    return -1;
+  }
+  size_t len = ntohs(nlen);
+  if (len >= reply_size || recv(fd, reply, len, MSG_WAITALL) != (ssize_t)len)
+  {
+    close(fd);
+    return -1;
+  }
+  reply[len] = '\0';
+  close(fd);
+  return 0;
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  char reply[64];
+  msg(expectedreply);
+  if (timed_call(sendmsg, reply, sizeof(reply)) != 0)
+    strcpy(reply, "(no reply)");
+  printf("%s\n", reply);
+}
+
+void test_recv(int fd, const char *t)
+{
+  struct timeval tv = {REPLY_TIMEOUT, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  msg(t);
+  uint16_t nlen;
+  char buf[64];
+  if (recv(fd, &nlen, sizeof(nlen), MSG_WAITALL) != sizeof(nlen) ||
+      ntohs(nlen) >= sizeof(buf) ||
+      recv(fd, buf, ntohs(nlen), MSG_WAITALL) != ntohs(nlen))
+  {
+    printf("RECV: (nothing)\n");
+    return;
+  }
+  buf[ntohs(nlen)] = '\0';
+  printf("RECV: %s\n", buf);
+}
+
+int connect_to_controller(int rcvbuf)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (rcvbuf > 0)
+  {
+    // Must be set before connect() so the advertised window stays small
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  }
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    // Keep the controller's per-call logging out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
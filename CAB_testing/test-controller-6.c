@@ -0,0 +1,135 @@
+#include "shared.h"
+
+// Tester for controller (messages split across reads, and several in one read)
+
+/*
+    Alpha
+  3 -----
+  2 |   |
+  1 -----
+
+  Alpha sends its CAR and STATUS messages in a single write, then sends a
+  later STATUS a byte at a time. The controller must see every message
+  exactly once however the bytes are grouped.
+*/
+
+#define DELAY 50000      // 50ms
+#define MILLISECOND 1000 // 1ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void frame(char *, size_t *, const char *);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  // Register and report status in one write
+  int alpha = connect_to_controller();
+  char batch[128];
+  size_t batch_len = 0;
+  frame(batch, &batch_len, "CAR Alpha 1 3");
+  frame(batch, &batch_len, "STATUS Closed 1 1");
+  send_looped(alpha, batch, batch_len);
+  usleep(DELAY);
+
+  // Only possible if the CAR message in the batch was seen
+  test_call("CALL 1 3", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 1");
+
+  // Arrive at floor 1 one byte at a time; the controller should then send floor 3
+  char split[64];
+  size_t split_len = 0;
+  frame(split, &split_len, "STATUS Opening 1 1");
+  for (size_t i = 0; i < split_len; i++)
+  {
+    send_looped(alpha, split + i, 1);
+    usleep(MILLISECOND);
+  }
+  test_recv(alpha, "RECV: FLOOR 3");
+
+  // A call that arrives in two pieces
+  int fd = connect_to_controller();
+  char call[32];
+  size_t call_len = 0;
+  frame(call, &call_len, "CALL 2 1");
+  send_looped(fd, call, 3);
+  usleep(DELAY);
+  send_looped(fd, call + 3, call_len - 3);
+  msg("CAR Alpha");
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+
+  cleanup(p);
+
+  close(alpha);
+
+  printf("\nTests completed.\n");
+}
+
+// frame: append one length-prefixed message to buf
+void frame(char *buf, size_t *len, const char *text)
+{
+  uint16_t nlen = htons(strlen(text));
+  memcpy(buf + *len, &nlen, sizeof(nlen));
+  memcpy(buf + *len + sizeof(nlen), text, strlen(text));
+  *len += sizeof(nlen) + strlen(text);
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *m = receive_msg(fd);
+  printf("RECV: %s\n", m);
+  free(m);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,118 @@
+#include "shared.h"
+
+// Tester for controller (call pad sessions: many tagged calls on one connection)
+
+/*
+    Alpha
+  3 -----
+  2 |   |
+  1 -----
+
+  A session starts with SESSION. After that every CALL carries an id, and
+  the reply to it carries the same id. The pad sends three calls in one
+  write without waiting, then a bad command, then one more call; the
+  session has to stay open throughout.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void frame(char *, size_t *, const char *);
+void test_reply(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 3");
+  send_message(alpha, "STATUS Closed 1 1");
+  usleep(DELAY);
+
+  int pad = connect_to_controller();
+  send_message(pad, "SESSION");
+  test_reply(pad, "SESSION OK");
+
+  // Pipeline three calls in a single write
+  char batch[128];
+  size_t batch_len = 0;
+  frame(batch, &batch_len, "CALL 1 1 3");
+  frame(batch, &batch_len, "CALL 2 B1 1");
+  frame(batch, &batch_len, "CALL 3 2 1");
+  send_looped(pad, batch, batch_len);
+  test_reply(pad, "CAR 1 Alpha");
+  test_reply(pad, "UNAVAILABLE 2");
+  test_reply(pad, "CAR 3 Alpha");
+
+  // Errors don't end the session
+  send_message(pad, "HELLO");
+  test_reply(pad, "ERROR Unknown command");
+  send_message(pad, "CALL 17 3 1");
+  test_reply(pad, "CAR 17 Alpha");
+
+  // One-shot calls still work alongside
+  int fd = connect_to_controller();
+  send_message(fd, "CALL 1 2");
+  test_reply(fd, "CAR Alpha");
+  close(fd);
+
+  cleanup(p);
+
+  close(pad);
+  close(alpha);
+
+  printf("\nTests completed.\n");
+}
+
+// frame: append one length-prefixed message to buf
+void frame(char *buf, size_t *len, const char *text)
+{
+  uint16_t nlen = htons(strlen(text));
+  memcpy(buf + *len, &nlen, sizeof(nlen));
+  memcpy(buf + *len + sizeof(nlen), text, strlen(text));
+  *len += sizeof(nlen) + strlen(text);
+}
+
+void test_reply(int fd, const char *expected)
+{
+  msg(expected);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,176 @@
+#include "shared.h"
+
+// Tester for controller (binary protocol, negotiated in the CAR handshake)
+
+/*
+    Alpha  Beta
+  3 -----
+  2 |   |  -----
+  1 |   |  |   |
+ B1 -----  -----
+
+  Alpha offers BINARY when registering and gets PROTOCOL 2 back; from then
+  on its STATUS and FLOOR messages are 8-byte binary messages with floors as
+  signed 16-bit integers. Beta doesn't offer, and stays on text.
+*/
+
+#define DELAY 50000 // 50ms
+
+#define V2_STATUS 1
+#define V2_FLOOR 2
+#define V2_CLOSED 3  // CarStatus values
+#define V2_OPENING 0
+
+pid_t controller(void);
+int connect_to_controller(void);
+void send_binary_status(int, uint16_t, uint8_t, int16_t, int16_t);
+void test_binary_recv(int, const char *);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha B1 3 BINARY");
+  test_recv(alpha, "RECV: PROTOCOL 2");
+  send_binary_status(alpha, 0, V2_CLOSED, -1, -1);
+
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta B1 2");
+  send_message(beta, "STATUS Closed 2 2");
+  usleep(DELAY);
+
+  // Alpha is first in line and already at B1
+  test_call("CALL B1 3", "CAR Alpha");
+  test_binary_recv(alpha, "RECV: FLOOR B1 (seq 0)");
+
+  // Arrives at B1, gets sent on to 3
+  send_binary_status(alpha, 1, V2_OPENING, -1, -1);
+  test_binary_recv(alpha, "RECV: FLOOR 3 (seq 1)");
+
+  // Neither car reaches floor 4
+  test_call("CALL 4 1", "UNAVAILABLE");
+
+  // Beta still gets text FLOORs
+  close(alpha);
+  usleep(DELAY);
+  test_call("CALL 1 2", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 1");
+
+  // A registration missing a floor, or offering something other than BINARY, is refused
+  int gamma = connect_to_controller();
+  send_message(gamma, "CAR Gamma 4");
+  test_recv(gamma, "RECV: ERROR Malformed CAR registration");
+  close(gamma);
+  int delta = connect_to_controller();
+  send_message(delta, "CAR Delta B1 4 TEXT");
+  test_recv(delta, "RECV: ERROR Malformed CAR registration");
+  close(delta);
+  test_call("CALL 4 1", "UNAVAILABLE");
+
+  cleanup(p);
+
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+void send_binary_status(int fd, uint16_t seq, uint8_t status, int16_t current, int16_t dest)
+{
+  unsigned char buf[2 + 8];
+  uint16_t nlen = htons(8);
+  uint16_t nseq = htons(seq);
+  uint16_t ncurrent = htons((uint16_t)current);
+  uint16_t ndest = htons((uint16_t)dest);
+  memcpy(buf, &nlen, 2);
+  buf[2] = V2_STATUS;
+  buf[3] = status;
+  memcpy(buf + 4, &nseq, 2);
+  memcpy(buf + 6, &ncurrent, 2);
+  memcpy(buf + 8, &ndest, 2);
+  send_looped(fd, buf, sizeof(buf));
+}
+
+void test_binary_recv(int fd, const char *t)
+{
+  msg(t);
+  uint16_t nlen;
+  recv_looped(fd, &nlen, sizeof(nlen));
+  unsigned char buf[64];
+  uint16_t len = ntohs(nlen);
+  if (len != 8)
+  {
+    printf("RECV: %u byte message\n", len);
+    if (len <= sizeof(buf))
+      recv_looped(fd, buf, len);
+    return;
+  }
+  recv_looped(fd, buf, len);
+
+  uint16_t seq, floor;
+  memcpy(&seq, buf + 2, 2);
+  memcpy(&floor, buf + 4, 2);
+  int16_t f = (int16_t)ntohs(floor);
+  if (buf[0] != V2_FLOOR)
+    printf("RECV: message type %d\n", buf[0]);
+  else if (f < 0)
+    printf("RECV: FLOOR B%d (seq %u)\n", -f, ntohs(seq));
+  else
+    printf("RECV: FLOOR %d (seq %u)\n", f, ntohs(seq));
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *m = receive_msg(fd);
+  printf("RECV: %s\n", m);
+  free(m);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
@@ -0,0 +1,125 @@
+#include "shared.h"
+
+// Tester for controller (calls go to the car that can serve them soonest)
+
+/*
+    Alpha  Beta
+ 10 |   |  -----
+  . |   |  |   |
+  1 -----  |   |
+
+  Both cars cover floors 1 to 10. Alpha waits at 1 and Beta at 10, so a
+  call near the top should go to Beta even though Alpha registered first.
+  Once Alpha is busy with a long trip, a call it would only reach after
+  finishing goes to Beta as well.
+*/
+
+#define DELAY 50000 // 50ms
+
+pid_t controller(void);
+int connect_to_controller(void);
+void test_call(const char *, const char *);
+void test_recv(int, const char *);
+void cleanup(pid_t);
+
+int main()
+{
+  pid_t p;
+  p = controller();
+  usleep(DELAY);
+
+  int alpha = connect_to_controller();
+  send_message(alpha, "CAR Alpha 1 10");
+  send_message(alpha, "STATUS Closed 1 1");
+  int beta = connect_to_controller();
+  send_message(beta, "CAR Beta 1 10");
+  send_message(beta, "STATUS Closed 10 10");
+  usleep(DELAY);
+
+  // Each goes to the nearer idle car
+  test_call("CALL 9 10", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 9");
+  test_call("CALL 2 1", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 2");
+
+  // Beta drops its passenger at 10 and sits there idle
+  send_message(beta, "STATUS Opening 9 9");
+  test_recv(beta, "RECV: FLOOR 10");
+  send_message(beta, "STATUS Opening 10 10");
+  send_message(beta, "STATUS Closed 10 10");
+
+  // Alpha drops its passenger at 1, then picks someone up there for 8
+  send_message(alpha, "STATUS Opening 2 2");
+  test_recv(alpha, "RECV: FLOOR 1");
+  send_message(alpha, "STATUS Opening 1 1");
+  send_message(alpha, "STATUS Closed 1 1");
+  usleep(DELAY);
+  test_call("CALL 1 8", "CAR Alpha");
+  test_recv(alpha, "RECV: FLOOR 1");
+  send_message(alpha, "STATUS Opening 1 1");
+  test_recv(alpha, "RECV: FLOOR 8");
+  send_message(alpha, "STATUS Between 1 8");
+  usleep(DELAY);
+
+  // Going down from 7 fits Beta's position better than Alpha's trip
+  test_call("CALL 7 3", "CAR Beta");
+  test_recv(beta, "RECV: FLOOR 7");
+
+  cleanup(p);
+
+  close(alpha);
+  close(beta);
+
+  printf("\nTests completed.\n");
+}
+
+void test_call(const char *sendmsg, const char *expectedreply)
+{
+  int fd = connect_to_controller();
+  send_message(fd, sendmsg);
+  msg(expectedreply);
+  char *reply = receive_msg(fd);
+  printf("%s\n", reply);
+  free(reply);
+  close(fd);
+}
+
+void test_recv(int fd, const char *t)
+{
+  msg(t);
+  char *m = receive_msg(fd);
+  printf("RECV: %s\n", m);
+  free(m);
+}
+
+int connect_to_controller(void)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(3000);
+  sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (const struct sockaddr *)&sockaddr, sizeof(sockaddr)) == -1)
+  {
+    perror("connect()");
+    exit(1);
+  }
+  return fd;
+}
+
+void cleanup(pid_t p)
+{
+  // Terminate with SIGINT to allow server to clean up
+  kill(p, SIGINT);
+}
+
+pid_t controller(void)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    execlp("./controller", "./controller", NULL);
+  }
+
+  return pid;
+}
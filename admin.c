@@ -0,0 +1,94 @@
+// Admin program - queries a running controller for its runtime statistics
+// Usage: ./admin stats | zones | traffic | latency [car]
+// Example: ./admin stats   - Print worker pool queue depth and utilisation, calls moved off cars
+//                            that left service and hall calls coalesced (--coalesce)
+//          ./admin zones   - Print the floors each car is zoned to (--zones)
+//          ./admin traffic - Print the traffic pattern and policy switches (--adaptive)
+//          ./admin latency - Print assign, wait, ride and call handling times for the fleet,
+//                            or for one car with ./admin latency <car>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "frame.h"
+#include "endpoint.h"
+
+#define REPLY_SIZE 65536 // Largest possible length-prefixed message plus terminator
+
+// recvAll: keep reading until exactly len bytes have arrived, returns 0 on success
+int recvAll(int sockfd, void *buffer, size_t len)
+{
+    char *ptr = buffer;
+    while (len > 0)
+    {
+        ssize_t n = recv(sockfd, ptr, len, 0);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// main: connect to the controller, send the admin command and print the reply
+int main(int argc, char *argv[])
+{
+    const char *command;
+    char latency_command[64];
+    if (argc == 2 && strcmp(argv[1], "stats") == 0)
+    {
+        command = "STATS";
+    }
+    else if (argc == 2 && strcmp(argv[1], "zones") == 0)
+    {
+        command = "ZONES";
+    }
+    else if (argc == 2 && strcmp(argv[1], "traffic") == 0)
+    {
+        command = "TRAFFIC";
+    }
+    else if ((argc == 2 || argc == 3) && strcmp(argv[1], "latency") == 0)
+    {
+        if (argc == 3)
+            snprintf(latency_command, sizeof(latency_command), "LATENCY %s", argv[2]);
+        else
+            snprintf(latency_command, sizeof(latency_command), "LATENCY");
+        command = latency_command;
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s stats | zones | traffic | latency [car]\n", argv[0]);
+        return 1;
+    }
+
+    int sockfd = endpointConnect(controllerEndpoint());
+    if (sockfd == -1)
+    {
+        printf("Unable to connect to elevator system.\n");
+        return 1;
+    }
+
+    frameSend(sockfd, command, 0);
+
+    uint16_t net_len;
+    static char reply[REPLY_SIZE];
+    if (recvAll(sockfd, &net_len, sizeof(net_len)) != 0 ||
+        recvAll(sockfd, reply, ntohs(net_len)) != 0)
+    {
+        printf("Controller closed the connection.\n");
+        close(sockfd);
+        return 1;
+    }
+    reply[ntohs(net_len)] = '\0';
+    printf("%s\n", reply);
+
+    close(sockfd);
+    return 0;
+}
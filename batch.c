@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "dispatch.h"
+#include "transfer.h"
+#include "latency.h"
+#include "log.h"
+#include "batch.h"
+
+#define INITIAL_CAPACITY 64
+
+// A call waiting for its window to close
+typedef struct
+{
+    int source;
+    int dest;
+    struct Connection *conn; // NULL once the connection has gone
+    char id[16];             // Session call id, "" for a one-shot call
+    long called;             // latency_clock() when it came in
+} PendingCall;
+
+// Calls collect in one buffer while the previous window's are being assigned from the
+// other; both are searched by batchCancel().
+typedef struct
+{
+    PendingCall *calls;
+    int count;
+    int capacity;
+} CallBuffer;
+
+int batch_window_ms = 0;
+
+static pthread_mutex_t batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond;
+static CallBuffer collecting;
+static CallBuffer assigning;
+static struct timespec window_end;
+
+// windowTimer: wait for a window to open, let it run its length, then assign and reply
+static void *windowTimer(void *arg)
+{
+    (void)arg;
+    BatchCall *calls = NULL;
+    char (*trips)[TRIP_REPLY_SIZE] = NULL; // --transfers replies for calls no one car could take
+    int calls_capacity = 0;
+
+    pthread_mutex_lock(&batch_mutex);
+    while (1)
+    {
+        while (collecting.count == 0)
+        {
+            pthread_cond_wait(&batch_cond, &batch_mutex);
+        }
+        while (pthread_cond_timedwait(&batch_cond, &batch_mutex, &window_end) == 0)
+        {
+            // Woken by a new call; the window still ends at the same time
+        }
+
+        // Swap buffers so new calls can keep arriving while this window is solved
+        CallBuffer closed = collecting;
+        collecting = assigning;
+        collecting.count = 0;
+        assigning = closed;
+        pthread_mutex_unlock(&batch_mutex);
+
+        if (calls_capacity < assigning.count)
+        {
+            calls_capacity = assigning.capacity;
+            calls = realloc(calls, calls_capacity * sizeof(BatchCall));
+            trips = realloc(trips, calls_capacity * sizeof(*trips));
+        }
+        for (int i = 0; i < assigning.count; i++)
+        {
+            calls[i].source = assigning.calls[i].source;
+            calls[i].dest = assigning.calls[i].dest;
+            calls[i].called = assigning.calls[i].called;
+        }
+        int assigned = assignBatch(calls, assigning.count);
+        logInfo("Batch of %d calls assigned %d\n", assigning.count, assigned);
+        for (int i = 0; i < assigning.count; i++)
+        {
+            trips[i][0] = '\0';
+            if (transfers_enabled && calls[i].car_name[0] == '\0')
+            {
+                assignTrip(calls[i].source, calls[i].dest, calls[i].called, trips[i], sizeof(trips[i]));
+            }
+        }
+
+        // Each call's wait for the window counts towards its assign time
+        long assigned_at = latency_clock();
+        for (int i = 0; i < assigning.count; i++)
+        {
+            if (calls[i].car_name[0] != '\0')
+                latencyRecordByName(calls[i].car_name, LATENCY_ASSIGN, assigned_at - calls[i].called);
+            else if (trips[i][0] != '\0')
+                latencyRecordByName(trips[i], LATENCY_ASSIGN, assigned_at - calls[i].called);
+        }
+
+        pthread_mutex_lock(&batch_mutex);
+        for (int i = 0; i < assigning.count; i++)
+        {
+            PendingCall *call = &assigning.calls[i];
+            if (call->conn != NULL)
+            {
+                const char *cars = NULL;
+                if (calls[i].car_name[0] != '\0')
+                    cars = calls[i].car_name;
+                else if (trips[i][0] != '\0')
+                    cars = trips[i];
+                sendCallReply(call->conn, call->id[0] != '\0' ? call->id : NULL, cars);
+            }
+        }
+        assigning.count = 0;
+    }
+
+    return NULL;
+}
+
+int batchStart(int window_ms)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&batch_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    collecting.capacity = assigning.capacity = INITIAL_CAPACITY;
+    collecting.calls = malloc(INITIAL_CAPACITY * sizeof(PendingCall));
+    assigning.calls = malloc(INITIAL_CAPACITY * sizeof(PendingCall));
+    batch_window_ms = window_ms;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, windowTimer, NULL) != 0)
+    {
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+void batchAddCall(int source, int dest, struct Connection *conn, const char *id)
+{
+    pthread_mutex_lock(&batch_mutex);
+    if (collecting.count == 0)
+    {
+        // First call opens the window
+        clock_gettime(CLOCK_MONOTONIC, &window_end);
+        window_end.tv_sec += batch_window_ms / 1000;
+        window_end.tv_nsec += (batch_window_ms % 1000) * 1000000L;
+        if (window_end.tv_nsec >= 1000000000L)
+        {
+            window_end.tv_sec++;
+            window_end.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_signal(&batch_cond);
+    }
+    if (collecting.count == collecting.capacity)
+    {
+        collecting.capacity *= 2;
+        collecting.calls = realloc(collecting.calls, collecting.capacity * sizeof(PendingCall));
+    }
+
+    PendingCall *call = &collecting.calls[collecting.count++];
+    call->source = source;
+    call->dest = dest;
+    call->conn = conn;
+    call->called = latency_clock();
+    snprintf(call->id, sizeof(call->id), "%s", id != NULL ? id : "");
+    pthread_mutex_unlock(&batch_mutex);
+}
+
+void batchCancel(struct Connection *conn)
+{
+    pthread_mutex_lock(&batch_mutex);
+    for (int i = 0; i < collecting.count; i++)
+    {
+        if (collecting.calls[i].conn == conn)
+            collecting.calls[i].conn = NULL;
+    }
+    for (int i = 0; i < assigning.count; i++)
+    {
+        if (assigning.calls[i].conn == conn)
+            assigning.calls[i].conn = NULL;
+    }
+    pthread_mutex_unlock(&batch_mutex);
+}
@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Batch mode (--batch <ms>): instead of going to a car the moment they
+// arrive, hall calls collect for a short window that opens with the first
+// one. When it closes, everything collected is assigned together with
+// assignBatch() and each caller gets its reply.
+//
+// Replies go out through sendCallReply(), which the network layer provides.
+// A connection that closes while its calls are waiting must call
+// batchCancel() first, after which it is never replied to.
+
+struct Connection;
+
+extern int batch_window_ms; // 0 unless running with --batch
+
+// batchStart: start the window timer thread. Returns 0, or -1 if it could not start.
+int batchStart(int window_ms);
+
+// batchAddCall: hold a call for the current window. id is the session's call id, or NULL
+// for a one-shot call.
+void batchAddCall(int source, int dest, struct Connection *conn, const char *id);
+void batchCancel(struct Connection *conn);
+
+// Provided by the network layer: queue the reply to a call, car_name NULL meaning
+// no car could take it (with --transfers, it can also be a trip such as "Alpha 20 Beta"). Called with the batch lock held.
+void sendCallReply(struct Connection *conn, const char *id, const char *car_name);
+
+#endif
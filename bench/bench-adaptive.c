@@ -0,0 +1,117 @@
+// Dispatch benchmark: each fixed dispatch policy vs --adaptive switching
+// between them, over a simulated day (fleet-sim.c).
+//
+// Usage: ./bench-adaptive [cars] [top_floor]
+//
+// The day runs through quiet spells between a morning up-peak, a lunchtime
+// two-way peak, an evening down-peak and a busy spell of travel between
+// upper floors, PHASE_STEPS steps each. Every policy gets the same
+// passengers; the adaptive run also prints the patterns it switched through.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dispatch.h"
+#include "zoning.h"
+#include "traffic.h"
+#include "fleet-sim.h"
+
+#define LOBBY 1
+#define PHASE_STEPS 2000
+
+typedef struct
+{
+    const char *name;
+    int per_thousand; // Arrivals per 1000 steps
+    int from_lobby;   // Percent of passengers starting at the lobby
+    int to_lobby;     // Percent heading for it; the rest go between upper floors
+} Phase;
+
+static const Phase day[] = {
+    {"quiet", 30, 30, 30},
+    {"up-peak", 400, 85, 5},
+    {"quiet", 30, 30, 30},
+    {"two-way", 300, 40, 40},
+    {"quiet", 30, 30, 30},
+    {"down-peak", 400, 5, 85},
+    {"interfloor", 300, 5, 5},
+    {"quiet", 30, 30, 30},
+};
+#define NUM_PHASES (int)(sizeof(day) / sizeof(day[0]))
+
+// dayTraffic: passengers for the whole day, sorted by arrival. Returns how many.
+static int dayTraffic(SimPassenger *passengers, int top_floor)
+{
+    unsigned int seed = 1;
+    int made = 0;
+    for (int ph = 0; ph < NUM_PHASES; ph++)
+    {
+        for (int s = 0; s < PHASE_STEPS; s++)
+        {
+            if ((int)(rand_r(&seed) % 1000) >= day[ph].per_thousand)
+                continue;
+            SimPassenger *p = &passengers[made++];
+            p->arrival = ph * PHASE_STEPS + s;
+            int kind = rand_r(&seed) % 100;
+            int upper = LOBBY + 1 + rand_r(&seed) % (top_floor - LOBBY);
+            if (kind < day[ph].from_lobby)
+            {
+                p->source = LOBBY;
+                p->dest = upper;
+            }
+            else if (kind < day[ph].from_lobby + day[ph].to_lobby)
+            {
+                p->source = upper;
+                p->dest = LOBBY;
+            }
+            else
+            {
+                p->source = upper;
+                do
+                {
+                    p->dest = LOBBY + 1 + rand_r(&seed) % (top_floor - LOBBY);
+                } while (p->dest == p->source);
+            }
+        }
+    }
+    return made;
+}
+
+int main(int argc, char *argv[])
+{
+    int num_cars = argc > 1 ? atoi(argv[1]) : 6;
+    int top_floor = argc > 2 ? atoi(argv[2]) : 40;
+    if (num_cars <= 0 || top_floor < 3 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    SimPassenger *passengers = malloc(NUM_PHASES * PHASE_STEPS * sizeof(SimPassenger));
+    int count = dayTraffic(passengers, top_floor);
+    fprintf(stderr, "%d passengers, %d cars, lobby 1 to floor %d, times in steps\n", count, num_cars, top_floor);
+    simPrintHeader();
+
+    const DispatchMode modes[] = {DISPATCH_ETA, DISPATCH_GROUP, DISPATCH_ETA, DISPATCH_GROUP, DISPATCH_ETA};
+    const int zoned[] = {0, 0, 1, 1, 0};
+    const char *labels[] = {"eta", "group", "eta zones", "group zones", "adaptive"};
+    for (int m = 0; m < 5; m++)
+    {
+        dispatch_mode = modes[m];
+        zoning_enabled = zoned[m];
+        traffic_adaptive = (m == 4);
+        SimConfig config = {num_cars, LOBBY, top_floor, 0};
+        SimResult result;
+        simRun(&config, passengers, count, &result);
+        simPrintResult(labels[m], &result);
+    }
+
+    char history[1024];
+    trafficDescribe(history, sizeof(history));
+    fprintf(stderr, "\n%s\n", history);
+
+    free(passengers);
+    return 0;
+}
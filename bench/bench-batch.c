@@ -0,0 +1,80 @@
+// Dispatch benchmark: greedy assignment vs windowed batch assignment.
+// Runs the same surge traffic through a simulated fleet (fleet-sim.c) with
+// calls assigned one at a time as they arrive, then held for windows of 1 to
+// 8 steps and assigned together with assignBatch().
+//
+// Usage: ./bench-batch [passengers] [cars] [top_floor]
+//
+// A step is one car delay, so with ./car ... 100 a 2-step window is
+// --batch 200. Traffic alternates 40-step surges of about one call a step
+// with 160-step lulls of one call every 20 steps, between random floors.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "fleet-sim.h"
+
+#define SURGE_STEPS 40
+#define LULL_STEPS 160
+
+// surgeTraffic: passengers arriving in bursts, sorted by arrival
+static void surgeTraffic(SimPassenger *passengers, int count, int top_floor)
+{
+    unsigned int seed = 1;
+    int step = 0;
+    int made = 0;
+    while (made < count)
+    {
+        int in_surge = (step % (SURGE_STEPS + LULL_STEPS)) < SURGE_STEPS;
+        int per_thousand = in_surge ? 1000 : 50;
+        if ((int)(rand_r(&seed) % 1000) < per_thousand)
+        {
+            SimPassenger *p = &passengers[made++];
+            p->arrival = step;
+            p->source = 1 + rand_r(&seed) % top_floor;
+            do
+            {
+                p->dest = 1 + rand_r(&seed) % top_floor;
+            } while (p->dest == p->source);
+        }
+        step++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int num_cars = argc > 2 ? atoi(argv[2]) : 4;
+    int top_floor = argc > 3 ? atoi(argv[3]) : 20;
+    if (count <= 0 || num_cars <= 0 || top_floor < 2 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [passengers] [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    SimPassenger *passengers = malloc(count * sizeof(SimPassenger));
+    surgeTraffic(passengers, count, top_floor);
+
+    fprintf(stderr, "%d passengers, %d cars, floors 1 to %d, times in steps\n", count, num_cars, top_floor);
+    simPrintHeader();
+
+    const int windows[] = {0, 1, 2, 4, 8};
+    for (int i = 0; i < 5; i++)
+    {
+        SimConfig config = {num_cars, 1, top_floor, windows[i]};
+        SimResult result;
+        simRun(&config, passengers, count, &result);
+
+        char label[32];
+        if (windows[i] == 0)
+            snprintf(label, sizeof(label), "greedy");
+        else
+            snprintf(label, sizeof(label), "batch %d", windows[i]);
+        simPrintResult(label, &result);
+    }
+
+    free(passengers);
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Dispatch benchmark: every call dispatched on its own vs --coalesce joining
+// calls to a car already on its way to the same floor, going the same way.
+// Runs the same passengers through a simulated fleet (fleet-sim.c).
+//
+// Usage: ./bench-coalesce [groups] [cars] [top_floor]
+//
+// Passengers come in groups: one to GROUP_MAX people on the same floor
+// heading the same way, to different floors, pressing the button within
+// GROUP_SPREAD steps of each other - a meeting letting out, or a crowd off a
+// train at the lobby. A group starts every GROUP_GAP steps on average.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dispatch.h"
+#include "fleet-sim.h"
+
+#define GROUP_MAX 4
+#define GROUP_SPREAD 6
+#define GROUP_GAP 12
+
+static int byArrival(const void *a, const void *b)
+{
+    return ((const SimPassenger *)a)->arrival - ((const SimPassenger *)b)->arrival;
+}
+
+// groupTraffic: passengers for a number of groups, sorted by arrival. Returns how many.
+static int groupTraffic(SimPassenger *passengers, int groups, int top_floor)
+{
+    unsigned int seed = 1;
+    int made = 0;
+    int step = 0;
+    for (int g = 0; g < groups; g++)
+    {
+        step += rand_r(&seed) % (2 * GROUP_GAP);
+        int source = 1 + rand_r(&seed) % top_floor;
+        int up = source == 1 || (source < top_floor && rand_r(&seed) % 2);
+        int size = 1 + rand_r(&seed) % GROUP_MAX;
+        for (int k = 0; k < size; k++)
+        {
+            SimPassenger *p = &passengers[made++];
+            p->arrival = step + rand_r(&seed) % GROUP_SPREAD;
+            p->source = source;
+            p->dest = up ? source + 1 + rand_r(&seed) % (top_floor - source)
+                         : 1 + rand_r(&seed) % (source - 1);
+        }
+    }
+    qsort(passengers, made, sizeof(SimPassenger), byArrival);
+    return made;
+}
+
+int main(int argc, char *argv[])
+{
+    int groups = argc > 1 ? atoi(argv[1]) : 1000;
+    int num_cars = argc > 2 ? atoi(argv[2]) : 4;
+    int top_floor = argc > 3 ? atoi(argv[3]) : 20;
+    if (groups <= 0 || num_cars <= 0 || top_floor < 2 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [groups] [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    SimPassenger *passengers = malloc(groups * GROUP_MAX * sizeof(SimPassenger));
+    int count = groupTraffic(passengers, groups, top_floor);
+    fprintf(stderr, "%d passengers in %d groups, %d cars, floors 1 to %d, times in steps\n", count, groups,
+            num_cars, top_floor);
+    simPrintHeader();
+
+    const DispatchMode modes[] = {DISPATCH_ETA, DISPATCH_ETA, DISPATCH_GROUP, DISPATCH_GROUP};
+    const char *labels[] = {"eta", "eta merged", "group", "group merged"};
+    char merges[4][128];
+    for (int m = 0; m < 4; m++)
+    {
+        dispatch_mode = modes[m];
+        coalesce_enabled = m % 2;
+        SimConfig config = {num_cars, 1, top_floor, 0};
+        SimResult result;
+        simRun(&config, passengers, count, &result);
+        simPrintResult(labels[m], &result);
+        coalesceDescribe(merges[m], sizeof(merges[m]));
+    }
+
+    // Every merged call is one call fewer costed against the whole fleet
+    fprintf(stderr, "\n");
+    for (int m = 1; m < 4; m += 2)
+    {
+        fprintf(stderr, "%-12s  %s\n", labels[m], merges[m]);
+    }
+
+    free(passengers);
+    return 0;
+}
@@ -0,0 +1,163 @@
+// Eligibility filtering for a call in a mixed bank: the old scan over every
+// car's floor range vs the registry's range index (findEligibleCars()), for
+// 10 to 10000 cars. Also times whole assignCall()s, which only cost the
+// eligible cars.
+//
+// Usage: ./bench-eligible [calls]
+//
+// The bank mixes basement-only cars, low-rise and high-rise cars meeting at
+// a sky lobby, express cars serving everything and penthouse shuttles. Each
+// call is between two floors of one of those ranges, chosen by how many cars
+// serve it, so most cars can't take most calls.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "registry.h"
+#include "dispatch.h"
+
+#define FAKE_SOCKFD_BASE 1000 // Cars are looked up by socket; these never touch the network
+
+typedef struct
+{
+    const char *lowest;
+    const char *highest;
+    int percent; // Of the fleet
+} CarKind;
+
+static const CarKind kinds[] = {
+    {"B5", "1", 10},  // Basement
+    {"1", "20", 35},  // Low-rise
+    {"20", "50", 35}, // High-rise, from the sky lobby
+    {"1", "50", 10},  // Express
+    {"45", "50", 10}, // Penthouse shuttle
+};
+#define NUM_KINDS (int)(sizeof(kinds) / sizeof(kinds[0]))
+
+// sendFloorToCar: the benchmark has no sockets, messages are dropped
+void sendFloorToCar(Car *car, int floor)
+{
+    (void)car;
+    (void)floor;
+}
+
+static double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// pickKind: a car kind, weighted by its share of the fleet
+static const CarKind *pickKind(unsigned int *seed)
+{
+    int roll = rand_r(seed) % 100;
+    for (int k = 0; k < NUM_KINDS; k++)
+    {
+        if ((roll -= kinds[k].percent) < 0)
+            return &kinds[k];
+    }
+    return &kinds[NUM_KINDS - 1];
+}
+
+// scanEligible: the filter assignCall used before the range index
+static int scanEligible(int source, int dest)
+{
+    int found = 0;
+    for (int i = 0; i < num_cars; i++)
+    {
+        Car *car = connected_cars[i];
+        if (!car->is_active)
+            continue;
+        if (source < car->lowest_floor || source > car->highest_floor ||
+            dest < car->lowest_floor || dest > car->highest_floor)
+            continue;
+        found++;
+    }
+    return found;
+}
+
+static void runOnce(int fleet_size, int num_calls)
+{
+    registryInit();
+    unsigned int seed = 1;
+    for (int i = 0; i < fleet_size; i++)
+    {
+        const CarKind *kind = pickKind(&seed);
+        char name[50];
+        sprintf(name, "Car%d", i);
+        handleCarRegistration(name, kind->lowest, kind->highest, FAKE_SOCKFD_BASE + i, NULL);
+    }
+
+    int *sources = malloc(num_calls * sizeof(int));
+    int *dests = malloc(num_calls * sizeof(int));
+    for (int c = 0; c < num_calls; c++)
+    {
+        const CarKind *kind = pickKind(&seed);
+        int lowest = floor_to_int(kind->lowest), span = floor_to_int(kind->highest) - lowest + 1;
+        sources[c] = lowest + rand_r(&seed) % span;
+        do
+        {
+            dests[c] = lowest + rand_r(&seed) % span;
+        } while (dests[c] == sources[c]);
+    }
+
+    struct timespec start;
+    long scanned = 0, indexed = 0;
+    Car **eligible = malloc(num_cars * sizeof(Car *));
+
+    registryReadLock();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < num_calls; c++)
+        scanned += scanEligible(sources[c], dests[c]);
+    double scan_time = secondsSince(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < num_calls; c++)
+        indexed += findEligibleCars(sources[c], dests[c], eligible);
+    double index_time = secondsSince(&start);
+    registryUnlock();
+
+    if (scanned != indexed)
+    {
+        fprintf(stderr, "Index found %ld cars, scan found %ld\n", indexed, scanned);
+        exit(1);
+    }
+
+    // Whole calls; each adds stops, so only a few to keep the routes short
+    int assign_calls = num_calls < 1000 ? num_calls : 1000;
+    char car_name[50];
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int c = 0; c < assign_calls; c++)
+        assignCall(sources[c], dests[c], car_name);
+    double assign_time = secondsSince(&start);
+
+    fprintf(stderr, "%6d  %13.1f  %12.0f  %13.0f  %12.0f\n", fleet_size, (double)indexed / num_calls,
+            scan_time / num_calls * 1e9, index_time / num_calls * 1e9, assign_time / assign_calls * 1e9);
+
+    free(eligible);
+    free(sources);
+    free(dests);
+}
+
+int main(int argc, char *argv[])
+{
+    int num_calls = argc > 1 ? atoi(argv[1]) : 20000;
+    if (num_calls <= 0)
+    {
+        fprintf(stderr, "Usage: %s [calls]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    fprintf(stderr, "%6s  %13s  %12s  %13s  %12s\n", "cars", "eligible/call", "scan ns/call", "index ns/call",
+            "assign ns");
+    const int sizes[] = {10, 100, 1000, 10000};
+    for (int i = 0; i < 4; i++)
+    {
+        runOnce(sizes[i], num_calls);
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+// Syscall benchmark for framed writes.
+// Sends STATUS-sized messages over a loopback TCP connection three ways:
+//   two-send  the old way, one send() for the length and one for the payload
+//   frameSend header and payload in one gather write
+//   batch     FRAME_BATCH_MAX queued frames per frameSendBatch(), as the
+//             controller's flushQueue does
+//
+// Usage: ./bench-framing [messages_per_run]
+//
+// send() and sendmsg() are wrapped at link time (-Wl,--wrap) so the counts
+// are the real number of syscalls made, including frame.c's own. The reader
+// side reports recv() calls per message, which rises when one message is
+// split over two segments.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "frame.h"
+
+#define MESSAGE "STATUS Between 12 13"
+
+static unsigned long send_syscalls;
+
+ssize_t __real_send(int sockfd, const void *buf, size_t len, int flags);
+ssize_t __real_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
+ssize_t __wrap_send(int sockfd, const void *buf, size_t len, int flags)
+{
+    send_syscalls++;
+    return __real_send(sockfd, buf, len, flags);
+}
+
+ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    send_syscalls++;
+    return __real_sendmsg(sockfd, msg, flags);
+}
+
+typedef struct
+{
+    int sockfd;
+    unsigned long expected;
+    unsigned long reads;
+} Reader;
+
+// readerThread: decode frames until the expected number have arrived
+static void *readerThread(void *arg)
+{
+    Reader *reader = arg;
+    FrameDecoder dec;
+    frameDecoderInit(&dec);
+
+    unsigned long frames = 0;
+    while (frames < reader->expected)
+    {
+        if (frameRead(&dec, reader->sockfd, 0) != FRAME_OK)
+            break;
+        reader->reads++;
+
+        FrameView frame;
+        while (frameNext(&dec, &frame) == 1)
+            frames++;
+    }
+    return NULL;
+}
+
+// connectedPair: a loopback TCP connection, both ends
+static void connectedPair(int *writer, int *reader)
+{
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    bind(listenfd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(listenfd, 1);
+    getsockname(listenfd, (struct sockaddr *)&addr, &addr_len);
+
+    *writer = socket(AF_INET, SOCK_STREAM, 0);
+    connect(*writer, (struct sockaddr *)&addr, sizeof(addr));
+    *reader = accept(listenfd, NULL, NULL);
+    close(listenfd);
+}
+
+// sendTwoCalls: the pre-frame.c way of writing a message
+static void sendTwoCalls(int sockfd, const char *msg)
+{
+    uint16_t len = strlen(msg);
+    uint16_t net_len = htons(len);
+    send(sockfd, &net_len, sizeof(net_len), 0);
+    send(sockfd, msg, len, 0);
+}
+
+static void runOnce(const char *name, int mode, unsigned long messages)
+{
+    int writer, readerfd;
+    connectedPair(&writer, &readerfd);
+
+    Reader reader = {readerfd, messages, 0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, readerThread, &reader);
+
+    // One pre-framed message, repeated, for the batch mode
+    char framed[sizeof(uint16_t) + sizeof(MESSAGE)];
+    uint16_t net_len = htons(strlen(MESSAGE));
+    memcpy(framed, &net_len, sizeof(net_len));
+    memcpy(framed + sizeof(net_len), MESSAGE, strlen(MESSAGE));
+    struct iovec iov[FRAME_BATCH_MAX];
+    for (int i = 0; i < FRAME_BATCH_MAX; i++)
+    {
+        iov[i].iov_base = framed;
+        iov[i].iov_len = sizeof(net_len) + strlen(MESSAGE);
+    }
+
+    send_syscalls = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long sent = 0;
+    while (sent < messages)
+    {
+        if (mode == 0)
+        {
+            sendTwoCalls(writer, MESSAGE);
+            sent++;
+        }
+        else if (mode == 1)
+        {
+            frameSend(writer, MESSAGE, 0);
+            sent++;
+        }
+        else
+        {
+            int count = messages - sent < FRAME_BATCH_MAX ? (int)(messages - sent) : FRAME_BATCH_MAX;
+            size_t want = count * iov[0].iov_len;
+            ssize_t n = frameSendBatch(writer, iov, count, 0);
+            if (n != (ssize_t)want)
+            {
+                fprintf(stderr, "short batch write\n");
+                exit(1);
+            }
+            sent += count;
+        }
+    }
+
+    pthread_join(thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%-10s  %14.3f  %14.3f  %12.0f\n", name,
+           (double)send_syscalls / messages, (double)reader.reads / messages, messages / seconds);
+
+    close(writer);
+    close(readerfd);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long messages = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    if (messages == 0)
+    {
+        fprintf(stderr, "Usage: %s [messages_per_run]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%lu messages of \"%s\" per run\n", messages, MESSAGE);
+    printf("%-10s  %14s  %14s  %12s\n", "method", "send calls/msg", "recv calls/msg", "msgs/s");
+    runOnce("two-send", 0, messages);
+    runOnce("frameSend", 1, messages);
+    runOnce("batch", 2, messages);
+    return 0;
+}
@@ -0,0 +1,169 @@
+// Contention benchmark for the controller's car registry.
+// Compares fine-grained locking (registry rwlock + one mutex per car) with the
+// old single cars_mutex design (coarse_locking), for 10, 100 and 1000 cars.
+//
+// Usage: ./bench-locking [seconds_per_run] [status_threads]
+//
+// Status threads each own a share of the cars and feed them STATUS updates,
+// mimicking cars moving between floors. One more thread issues CALLs at the
+// same time. The controller's own logging goes to /dev/null.
+//
+// Run with LOCKSTAT=1 to see what recording lock statistics costs, and
+// ./lockreport for where the time went.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "registry.h"
+#include "dispatch.h"
+
+#define FAKE_SOCKFD_BASE 1000 // Cars are looked up by socket; these never touch the network
+#define TOP_FLOOR 50
+
+typedef struct
+{
+    int first_car;
+    int stride;
+    int num_cars;
+    unsigned long ops;
+} StatusWorker;
+
+static volatile int running;
+static unsigned long calls_done;
+
+// sendFloorToCar: the benchmark has no sockets, messages are dropped
+void sendFloorToCar(Car *car, int floor)
+{
+    (void)car;
+    (void)floor;
+}
+
+// statusWorker: cycle each owned car through Closed -> Between -> Opening at the next floor
+static void *statusWorker(void *arg)
+{
+    StatusWorker *w = arg;
+    int step = 0;
+
+    while (running)
+    {
+        for (int c = w->first_car; c < w->num_cars && running; c += w->stride)
+        {
+            int here = 1 + (step + c) % (TOP_FLOOR - 1);
+            int next = here + 1;
+
+            int sockfd = FAKE_SOCKFD_BASE + c;
+            updateCarStatus(sockfd, CAR_CLOSED, here, next);
+            updateCarStatus(sockfd, CAR_BETWEEN, here, next);
+            updateCarStatus(sockfd, CAR_OPENING, next, next);
+            w->ops += 3;
+        }
+        step++;
+    }
+    return NULL;
+}
+
+// callWorker: hall calls between random floors
+static void *callWorker(void *arg)
+{
+    unsigned int seed = 1;
+    char car_name[50];
+    (void)arg;
+
+    while (running)
+    {
+        int source = 1 + rand_r(&seed) % TOP_FLOOR;
+        int dest = 1 + rand_r(&seed) % TOP_FLOOR;
+        if (source != dest)
+        {
+            assignCall(source, dest, car_name);
+            calls_done++;
+        }
+    }
+    return NULL;
+}
+
+// resetCars: fresh registry with fleet_size cars spanning every floor
+static void resetCars(int fleet_size)
+{
+    registryInit();
+
+    char top[4];
+    int_to_floor(TOP_FLOOR, top);
+    for (int i = 0; i < fleet_size; i++)
+    {
+        char name[50];
+        sprintf(name, "Car%d", i);
+        handleCarRegistration(name, "1", top, FAKE_SOCKFD_BASE + i, NULL);
+    }
+}
+
+static void runOnce(int fleet_size, int coarse, int seconds, int num_threads)
+{
+    coarse_locking = coarse;
+    resetCars(fleet_size);
+
+    StatusWorker workers[num_threads];
+    pthread_t threads[num_threads];
+    pthread_t call_thread;
+
+    running = 1;
+    calls_done = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < num_threads; t++)
+    {
+        workers[t] = (StatusWorker){t, num_threads, fleet_size, 0};
+        pthread_create(&threads[t], NULL, statusWorker, &workers[t]);
+    }
+    pthread_create(&call_thread, NULL, callWorker, NULL);
+
+    sleep(seconds);
+    running = 0;
+
+    unsigned long status_ops = 0;
+    for (int t = 0; t < num_threads; t++)
+    {
+        pthread_join(threads[t], NULL);
+        status_ops += workers[t].ops;
+    }
+    pthread_join(call_thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%6d  %-7s  %14.0f  %12.0f\n", fleet_size, coarse ? "coarse" : "fine",
+            status_ops / elapsed, calls_done / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 2;
+    int num_threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (seconds <= 0 || num_threads <= 0)
+    {
+        fprintf(stderr, "Usage: %s [seconds_per_run] [status_threads]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    if (lockstatInit("bench-locking") != 0)
+    {
+        perror("lockstatInit");
+    }
+    fprintf(stderr, "%d status threads + 1 call thread, %ds per run%s\n", num_threads, seconds,
+            lockstat_region != NULL ? ", recording lock statistics" : "");
+    fprintf(stderr, "%6s  %-7s  %14s  %12s\n", "cars", "locking", "status/s", "calls/s");
+
+    const int fleet_sizes[] = {10, 100, 1000};
+    for (int i = 0; i < 3; i++)
+    {
+        runOnce(fleet_sizes[i], 1, seconds, num_threads);
+        runOnce(fleet_sizes[i], 0, seconds, num_threads);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Logging benchmark: printf() vs log.c's ring buffers, from threads that log
+// while holding a shared mutex, as dispatch does with a car's lock held.
+//   printf    the old way, formatting and writing under the lock
+//   log       logInfo(): the record is copied, the drain thread prints it
+//   filtered  logDebug() with LOG_LEVEL=info: only the level test
+//
+// Usage: ./bench-logging [messages_per_thread] [threads]
+//
+// Output goes to a file (not the terminal), so printf() pays for the write
+// but not for a slow console; LOG_FILE points the log at the same file. A full ring drops records rather than wait;
+// "printed" counts what actually reached the file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "log.h"
+
+#define OUTPUT_FILE "/tmp/bench-logging.out"
+
+typedef enum
+{
+    MODE_PRINTF,
+    MODE_LOG,
+    MODE_FILTERED
+} Mode;
+
+static pthread_mutex_t car_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Mode mode;
+static int per_thread;
+
+static void *logger(void *arg)
+{
+    const char *name = arg;
+    char floor_str[4];
+    for (int i = 0; i < per_thread; i++)
+    {
+        snprintf(floor_str, sizeof(floor_str), "%d", i % 100);
+        pthread_mutex_lock(&car_mutex);
+        if (mode == MODE_PRINTF)
+            printf("Sent FLOOR %s to car %s\n", floor_str, name);
+        else if (mode == MODE_LOG)
+            logInfo("Sent FLOOR %s to car %s\n", floor_str, name);
+        else
+            logDebug("Sent FLOOR %s to car %s\n", floor_str, name);
+        pthread_mutex_unlock(&car_mutex);
+    }
+    return NULL;
+}
+
+// countPrinted: lines in the output file, plus records reported dropped
+static void countPrinted(long *printed, long *dropped)
+{
+    FILE *f = fopen(OUTPUT_FILE, "r");
+    char line[256];
+    *printed = *dropped = 0;
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL)
+    {
+        long n;
+        if (sscanf(line, "(%ld log records dropped)", &n) == 1)
+            *dropped += n;
+        else
+            (*printed)++;
+    }
+    if (f != NULL)
+        fclose(f);
+}
+
+static void runOnce(const char *label, Mode m, int num_threads)
+{
+    freopen(OUTPUT_FILE, "w", stdout);
+    mode = m;
+    log_level = m == MODE_FILTERED ? LOG_LEVEL_INFO : LOG_LEVEL_DEBUG;
+
+    char names[16][8];
+    pthread_t threads[16];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < num_threads; t++)
+    {
+        snprintf(names[t], sizeof(names[t]), "Car%d", t);
+        pthread_create(&threads[t], NULL, logger, names[t]);
+    }
+    for (int t = 0; t < num_threads; t++)
+        pthread_join(threads[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    logFlush();
+    fflush(stdout);
+    long printed, dropped;
+    countPrinted(&printed, &dropped);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    long total = (long)per_thread * num_threads;
+    fprintf(stderr, "%-9s %8d %12.0f %10.1f %10ld %10ld\n", label, num_threads, total / seconds,
+            seconds * 1e9 / total, printed, dropped);
+}
+
+int main(int argc, char *argv[])
+{
+    per_thread = argc > 1 ? atoi(argv[1]) : 200000;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 4;
+    if (per_thread <= 0 || max_threads <= 0 || max_threads > 16)
+    {
+        fprintf(stderr, "Usage: %s [messages_per_thread] [threads (1 to 16)]\n", argv[0]);
+        return 1;
+    }
+
+    setenv("LOG_FILE", OUTPUT_FILE, 1);
+    if (logStart() != 0)
+    {
+        perror("logStart");
+        return 1;
+    }
+    fprintf(stderr, "%d messages per thread, logged with a shared mutex held\n", per_thread);
+    fprintf(stderr, "%-9s %8s %12s %10s %10s %10s\n", "mode", "threads", "calls/s", "ns/call", "printed",
+            "dropped");
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        runOnce("printf", MODE_PRINTF, threads);
+        runOnce("log", MODE_LOG, threads);
+        runOnce("filtered", MODE_FILTERED, threads);
+    }
+    unlink(OUTPUT_FILE);
+    return 0;
+}
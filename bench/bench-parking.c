@@ -0,0 +1,145 @@
+// Dispatch benchmark: idle cars left where they stop vs parked by --park,
+// on a simulated fleet (fleet-sim.c).
+//
+// Usage: ./bench-parking [days] [cars] [top_floor]
+//
+// A step is 100ms, so a day is 864000 steps. Each day has the same shape:
+// a quiet night, a morning rush up from the lobby, a quiet morning with most
+// calls from a cafeteria floor, a lunchtime rush to and from it, a quiet
+// afternoon, an evening rush down to the lobby and a quiet evening. Parking
+// learns the shape on the first day. The quiet periods and the rushes are
+// then also run on their own (at the same times of day), to show parking
+// helps in the quiet and changes little in the rushes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "parking.h"
+#include "fleet-sim.h"
+
+#define LOBBY 1
+#define STEPS_PER_HOUR 36000
+
+typedef struct
+{
+    int until_hour;
+    int per_million;  // Arrivals per million steps
+    int from_lobby;   // Percent starting at the lobby
+    int to_lobby;     // Percent heading for it
+    int from_cafe;    // Percent starting at the cafeteria
+    int to_cafe;      // Percent heading for it; the rest go between random floors
+    int rush;
+} Period;
+
+static const Period day[] = {
+    {7, 300, 10, 10, 0, 0, 0},      // Night
+    {9, 250000, 85, 5, 0, 0, 1},    // Morning rush
+    {12, 2000, 20, 10, 40, 0, 0},   // Morning
+    {13, 150000, 5, 5, 30, 50, 1},  // Lunch
+    {17, 2000, 10, 20, 10, 10, 0},  // Afternoon
+    {19, 250000, 5, 85, 0, 0, 1},   // Evening rush
+    {24, 600, 30, 10, 0, 0, 0},     // Evening
+};
+#define NUM_PERIODS (int)(sizeof(day) / sizeof(day[0]))
+
+static int randomFloor(unsigned int *seed, int top_floor)
+{
+    return LOBBY + rand_r(seed) % (top_floor - LOBBY + 1);
+}
+
+typedef enum
+{
+    ALL_DAY,
+    QUIET_ONLY,
+    RUSHES_ONLY
+} Periods;
+
+// makeTraffic: passengers for a number of days, in the periods asked for.
+// Returns how many, sorted by arrival.
+static int makeTraffic(SimPassenger *passengers, int max, int days, int top_floor, Periods periods)
+{
+    unsigned int seed = 1;
+    int cafe = (LOBBY + top_floor) / 2;
+    int made = 0;
+    long step = 0;
+    for (int d = 0; d < days; d++)
+    {
+        int from_hour = 0;
+        for (int p = 0; p < NUM_PERIODS; p++)
+        {
+            const Period *period = &day[p];
+            long length = (long)(period->until_hour - from_hour) * STEPS_PER_HOUR;
+            from_hour = period->until_hour;
+            int wanted = periods == ALL_DAY || (periods == RUSHES_ONLY) == period->rush;
+
+            for (long s = 0; s < length; s++, step++)
+            {
+                if ((int)(rand_r(&seed) % 1000000) >= period->per_million || !wanted || made == max)
+                    continue;
+                SimPassenger *passenger = &passengers[made++];
+                passenger->arrival = step;
+                int kind = rand_r(&seed) % 100;
+                int from = randomFloor(&seed, top_floor), to = randomFloor(&seed, top_floor);
+                if ((kind -= period->from_lobby) < 0)
+                    from = LOBBY;
+                else if ((kind -= period->to_lobby) < 0)
+                    to = LOBBY;
+                else if ((kind -= period->from_cafe) < 0)
+                    from = cafe;
+                else if ((kind -= period->to_cafe) < 0)
+                    to = cafe;
+                while (to == from)
+                    to = randomFloor(&seed, top_floor);
+                passenger->source = from;
+                passenger->dest = to;
+            }
+        }
+    }
+    return made;
+}
+
+// run: each passenger set without and with parking
+static void run(const char *title, SimPassenger *passengers, int count, int num_cars, int top_floor)
+{
+    fprintf(stderr, "\n%s: %d passengers\n", title, count);
+    simPrintHeader();
+    const char *labels[] = {"stay", "park"};
+    for (int m = 0; m < 2; m++)
+    {
+        parking_enabled = m;
+        SimConfig config = {num_cars, LOBBY, top_floor, 0};
+        SimResult result;
+        simRun(&config, passengers, count, &result);
+        simPrintResult(labels[m], &result);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int days = argc > 1 ? atoi(argv[1]) : 3;
+    int num_cars = argc > 2 ? atoi(argv[2]) : 4;
+    int top_floor = argc > 3 ? atoi(argv[3]) : 20;
+    if (days <= 0 || num_cars <= 0 || top_floor < 3 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [days] [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    int max = 200000;
+    SimPassenger *passengers = malloc(max * sizeof(SimPassenger));
+    fprintf(stderr, "%d cars, lobby 1 to floor %d, times in steps\n", num_cars, top_floor);
+
+    int count = makeTraffic(passengers, max, days, top_floor, ALL_DAY);
+    run("Whole days", passengers, count, num_cars, top_floor);
+
+    count = makeTraffic(passengers, max, days, top_floor, QUIET_ONLY);
+    run("Quiet periods only", passengers, count, num_cars, top_floor);
+
+    count = makeTraffic(passengers, max, days, top_floor, RUSHES_ONLY);
+    run("Rushes only", passengers, count, num_cars, top_floor);
+
+    free(passengers);
+    return 0;
+}
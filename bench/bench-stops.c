@@ -0,0 +1,201 @@
+// Microbenchmark for a car's pending-stop route.
+// Keeps a route of N stops and repeatedly does what the controller does to
+// it: a car arrives (pop the next stop, find the new peak) and a call comes
+// in (add a floor, find the new peak). Two ways:
+//   list     the old malloc'd Node list, walked for every lookup and insert
+//            and rescanned for the peak after every change
+//   stopset  stopset.c, peak and trough kept up to date as stops change
+//
+// Usage: ./bench-stops [updates_per_run]
+//
+// A route holds each floor at most once, so N is capped at the STOP_FLOORS
+// floors from B99 to 999.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stopset.h"
+
+typedef struct Node
+{
+    int floor;
+    struct Node *next;
+} Node;
+
+typedef struct
+{
+    Node *queue;
+    int peak;
+} ListRoute;
+
+// listContains: the old is_floor_in_queue
+static int listContains(Node *queue, int floor)
+{
+    for (Node *n = queue; n != NULL; n = n->next)
+    {
+        if (n->floor == floor)
+            return 1;
+    }
+    return 0;
+}
+
+// listPeak: the old rescan after every change
+static int listPeak(Node *queue)
+{
+    int peak = queue->floor;
+    for (Node *n = queue; n != NULL; n = n->next)
+    {
+        if (n->floor > peak)
+            peak = n->floor;
+    }
+    return peak;
+}
+
+// listAddDescent: the old append_to_descent
+static void listAddDescent(ListRoute *route, int floor)
+{
+    if (listContains(route->queue, floor))
+        return;
+
+    Node *node = malloc(sizeof(Node));
+    node->floor = floor;
+    node->next = NULL;
+    if (route->queue == NULL)
+    {
+        route->queue = node;
+        route->peak = floor;
+        return;
+    }
+
+    Node *curr = route->queue;
+    while (curr->next != NULL && curr->floor != route->peak)
+        curr = curr->next;
+    while (curr->next != NULL && curr->next->floor > floor)
+        curr = curr->next;
+    node->next = curr->next;
+    curr->next = node;
+    route->peak = listPeak(route->queue);
+}
+
+// listPop: the old STATUS Opening branch
+static int listPop(ListRoute *route)
+{
+    Node *head = route->queue;
+    int floor = head->floor;
+    route->queue = head->next;
+    free(head);
+    if (route->queue != NULL)
+        route->peak = listPeak(route->queue);
+    return floor;
+}
+
+static double elapsed(struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// shuffledFloors: every floor a route can hold, in random order
+static void shuffledFloors(int *floors)
+{
+    for (int i = 0; i < STOP_FLOORS; i++)
+        floors[i] = STOP_MIN_FLOOR + i;
+    for (int i = STOP_FLOORS - 1; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        int tmp = floors[i];
+        floors[i] = floors[j];
+        floors[j] = tmp;
+    }
+}
+
+static void runSize(int requested, long updates)
+{
+    int stops = requested < STOP_FLOORS ? requested : STOP_FLOORS;
+    int shuffled[STOP_FLOORS];
+    shuffledFloors(shuffled);
+    int floors[STOP_FLOORS];
+    memcpy(floors, shuffled, sizeof(floors));
+
+    // Each popped floor is called again straight away, so the route keeps
+    // its size; the floors not in it wait their turn in spare[].
+    ListRoute list = {NULL, 0};
+    for (int i = 0; i < stops; i++)
+        listAddDescent(&list, floors[i]);
+
+    int spare_count = STOP_FLOORS - stops;
+    int *spare = floors + stops;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long checksum = 0;
+    for (long i = 0; i < updates; i++)
+    {
+        int floor = listPop(&list);
+        if (spare_count > 0)
+        {
+            int next = spare[i % spare_count];
+            spare[i % spare_count] = floor;
+            floor = next;
+        }
+        listAddDescent(&list, floor);
+        checksum += list.peak;
+    }
+    double list_seconds = elapsed(&start);
+
+    // Same sequence of floors for the stop set
+    memcpy(floors, shuffled, sizeof(floors));
+    StopSet set;
+    stopSetInit(&set);
+    for (int i = 0; i < stops; i++)
+        stopSetAddDescent(&set, floors[i]);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < updates; i++)
+    {
+        int floor = stopSetHead(&set);
+        stopSetPop(&set);
+        if (spare_count > 0)
+        {
+            int next = spare[i % spare_count];
+            spare[i % spare_count] = floor;
+            floor = next;
+        }
+        stopSetAddDescent(&set, floor);
+        checksum += stopSetPeak(&set) + stopSetTrough(&set);
+    }
+    double set_seconds = elapsed(&start);
+
+    // Two updates (one pop, one call) per iteration
+    printf("%6d  %6d  %14.1f  %14.1f  %8.1fx\n", requested, stops,
+           list_seconds * 1e9 / (2 * updates), set_seconds * 1e9 / (2 * updates),
+           list_seconds / set_seconds);
+
+    while (list.queue != NULL)
+        listPop(&list);
+    if (checksum == 42)
+        printf("\n"); // Keeps the loops from being optimised away
+}
+
+int main(int argc, char *argv[])
+{
+    long updates = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    if (updates <= 0)
+    {
+        fprintf(stderr, "Usage: %s [updates_per_run]\n", argv[0]);
+        return 1;
+    }
+
+    static const int sizes[] = {10, 50, 200, 500, 1000, 2000};
+
+    printf("%ld pops + %ld calls per run\n", updates, updates);
+    printf("%6s  %6s  %14s  %14s  %9s\n", "asked", "stops", "list ns/update", "set ns/update", "speedup");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        srand(1);
+        runSize(sizes[i], updates);
+    }
+    return 0;
+}
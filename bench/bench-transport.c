@@ -0,0 +1,166 @@
+// Latency benchmark: STATUS -> FLOOR round trip over loopback TCP vs a Unix-domain socket.
+//
+// Usage: ./bench-transport [round_trips] [controller_binary]
+//
+// Starts the real controller (default ../controller) with --unix, and for
+// each transport registers a fake car covering floors 1 to 999. A call pad
+// session then queues round_trips + 1 floors for it. The car answers every
+// FLOOR with "STATUS Opening <floor> <floor>", and the controller pops that
+// floor and sends the next one. The time from sending that STATUS to
+// getting the next FLOOR is one round trip through the controller's read,
+// dispatch and write path.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include "frame.h"
+#include "endpoint.h"
+
+#define UNIX_PATH "/tmp/bench-transport.sock"
+#define TOP_FLOOR 999
+#define REPLY_TIMEOUT_MS 1000
+#define SETTLE_MS 100 // Quiet time that means the controller has sent everything it is going to
+
+static double nowMicros(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// nextFrame: wait up to timeout_ms for a whole message, copying it into buf; -1 on timeout
+static int nextFrame(int sockfd, FrameDecoder *dec, char *buf, size_t size, int timeout_ms)
+{
+    FrameView frame;
+    while (frameNext(dec, &frame) != 1)
+    {
+        struct pollfd pfd = {sockfd, POLLIN, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0 || frameRead(dec, sockfd, 0) != FRAME_OK)
+        {
+            return -1;
+        }
+    }
+    snprintf(buf, size, "%s", frame.data);
+    return 0;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void runOnce(const char *label, const char *endpoint, const char *car_name, int round_trips)
+{
+    int car = endpointConnect(endpoint);
+    int pad = endpointConnect(endpoint);
+    if (car == -1 || pad == -1)
+    {
+        perror(endpoint);
+        exit(1);
+    }
+
+    FrameDecoder car_in, pad_in;
+    frameDecoderInit(&car_in);
+    frameDecoderInit(&pad_in);
+    char msg[64];
+
+    snprintf(msg, sizeof(msg), "CAR %s 1 %d", car_name, TOP_FLOOR);
+    frameSend(car, msg, 0);
+    frameSend(car, "STATUS Closed 1 1", 0);
+
+    // Queue floors 1..round_trips+1, then wait for every reply so the route is in place
+    frameSend(pad, "SESSION", 0);
+    nextFrame(pad, &pad_in, msg, sizeof(msg), REPLY_TIMEOUT_MS);
+    for (int i = 1; i <= round_trips; i++)
+    {
+        snprintf(msg, sizeof(msg), "CALL %d %d %d", i, i, i + 1);
+        frameSend(pad, msg, 0);
+    }
+    for (int i = 1; i <= round_trips; i++)
+    {
+        nextFrame(pad, &pad_in, msg, sizeof(msg), REPLY_TIMEOUT_MS);
+    }
+
+    // Queueing sends the car a FLOOR whenever the head of its route changes; the last one counts
+    char floor[8] = "";
+    while (nextFrame(car, &car_in, msg, sizeof(msg), SETTLE_MS) == 0)
+    {
+        sscanf(msg, "FLOOR %7s", floor);
+    }
+
+    double *samples = malloc(sizeof(double) * round_trips);
+    int count = 0;
+    if (floor[0] != '\0')
+    {
+        while (count < round_trips)
+        {
+            snprintf(msg, sizeof(msg), "STATUS Opening %s %s", floor, floor);
+            double start = nowMicros();
+            frameSend(car, msg, 0);
+            if (nextFrame(car, &car_in, msg, sizeof(msg), REPLY_TIMEOUT_MS) != 0 || sscanf(msg, "FLOOR %7s", floor) != 1)
+            {
+                break; // Route finished early
+            }
+            samples[count++] = nowMicros() - start;
+        }
+    }
+
+    qsort(samples, count, sizeof(double), compareDoubles);
+    double total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        total += samples[i];
+    }
+    if (count > 0)
+    {
+        printf("%-6s  %11d  %9.1f  %9.1f  %9.1f\n", label, count, total / count,
+               samples[count / 2], samples[(int)(count * 0.99)]);
+    }
+    else
+    {
+        printf("%-6s  no round trips completed\n", label);
+    }
+
+    free(samples);
+    close(pad);
+    close(car);
+}
+
+int main(int argc, char *argv[])
+{
+    int round_trips = argc > 1 ? atoi(argv[1]) : 500;
+    const char *controller = argc > 2 ? argv[2] : "../controller";
+    if (round_trips <= 0 || round_trips >= TOP_FLOOR)
+    {
+        fprintf(stderr, "Usage: %s [round_trips (1-%d)] [controller_binary]\n", argv[0], TOP_FLOOR - 1);
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        freopen("/dev/null", "w", stdout);
+        execl(controller, controller, "--unix", UNIX_PATH, (char *)NULL);
+        perror(controller);
+        _exit(1);
+    }
+    usleep(200000); // Let it bind
+
+    printf("%d STATUS -> FLOOR round trips per transport (microseconds)\n", round_trips);
+    printf("%-6s  %11s  %9s  %9s  %9s\n", "", "round trips", "mean", "p50", "p99");
+    runOnce("tcp", "127.0.0.1:3000", "TcpCar", round_trips);
+    usleep(100000); // TcpCar's disconnect is handled before the next car registers
+    runOnce("unix", "unix:" UNIX_PATH, "UnixCar", round_trips);
+
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+    unlink(UNIX_PATH);
+    return 0;
+}
@@ -0,0 +1,95 @@
+// Dispatch benchmark: estimated-time dispatch vs destination grouping in a
+// lobby up-peak (the morning rush), on a simulated fleet (fleet-sim.c).
+//
+// Usage: ./bench-uppeak [passengers] [cars] [top_floor]
+//
+// Most passengers arrive at the lobby (floor 1) heading up to a random
+// floor; a few come down to the lobby or travel between upper floors. Each
+// arrival rate runs once per dispatch mode on the same passengers. Handling
+// capacity is passengers delivered per 100 steps, a step being one car delay.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dispatch.h"
+#include "fleet-sim.h"
+
+#define LOBBY 1
+#define UP_PERCENT 85   // Lobby to an upper floor
+#define DOWN_PERCENT 10 // Upper floor to the lobby, the rest go between upper floors
+
+// upPeakTraffic: passengers arriving at per_thousand per step, sorted by arrival
+static void upPeakTraffic(SimPassenger *passengers, int count, int top_floor, int per_thousand)
+{
+    unsigned int seed = 1;
+    int step = 0;
+    int made = 0;
+    while (made < count)
+    {
+        if ((int)(rand_r(&seed) % 1000) < per_thousand)
+        {
+            SimPassenger *p = &passengers[made++];
+            int kind = rand_r(&seed) % 100;
+            int upper = LOBBY + 1 + rand_r(&seed) % (top_floor - LOBBY);
+            p->arrival = step;
+            if (kind < UP_PERCENT)
+            {
+                p->source = LOBBY;
+                p->dest = upper;
+            }
+            else if (kind < UP_PERCENT + DOWN_PERCENT)
+            {
+                p->source = upper;
+                p->dest = LOBBY;
+            }
+            else
+            {
+                p->source = upper;
+                do
+                {
+                    p->dest = LOBBY + 1 + rand_r(&seed) % (top_floor - LOBBY);
+                } while (p->dest == p->source);
+            }
+        }
+        step++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int num_cars = argc > 2 ? atoi(argv[2]) : 4;
+    int top_floor = argc > 3 ? atoi(argv[3]) : 20;
+    if (count <= 0 || num_cars <= 0 || top_floor < 3 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [passengers] [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    SimPassenger *passengers = malloc(count * sizeof(SimPassenger));
+    fprintf(stderr, "%d passengers, %d cars, lobby 1 to floor %d, times in steps\n", count, num_cars, top_floor);
+
+    const int rates[] = {100, 250, 500};
+    for (int r = 0; r < 3; r++)
+    {
+        upPeakTraffic(passengers, count, top_floor, rates[r]);
+        fprintf(stderr, "\n%.2f arrivals per step\n", rates[r] / 1000.0);
+        simPrintHeader();
+
+        const DispatchMode modes[] = {DISPATCH_ETA, DISPATCH_GROUP};
+        const char *labels[] = {"eta", "group"};
+        for (int m = 0; m < 2; m++)
+        {
+            dispatch_mode = modes[m];
+            SimConfig config = {num_cars, LOBBY, top_floor, 0};
+            SimResult result;
+            simRun(&config, passengers, count, &result);
+            simPrintResult(labels[m], &result);
+        }
+    }
+
+    free(passengers);
+    return 0;
+}
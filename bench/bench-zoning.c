@@ -0,0 +1,108 @@
+// Dispatch benchmark: whole-building dispatch vs dynamic zoning (--zones) in
+// a tall building, on a simulated fleet (fleet-sim.c).
+//
+// Usage: ./bench-zoning [passengers] [cars] [top_floor]
+//
+// Half the passengers travel between the lobby (floor 1) and an upper
+// floor, half between two upper floors. Most of the upper floors they use
+// fall in a busy band a fifth of the building high, which moves to a new
+// part of the building every BAND_STEPS steps, so the zones have to follow
+// it. Floors/trip is how far the fleet travelled per passenger delivered.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "dispatch.h"
+#include "zoning.h"
+#include "fleet-sim.h"
+
+#define LOBBY 1
+#define LOBBY_PERCENT 50 // To or from the lobby, the rest between upper floors
+#define BAND_PERCENT 80  // Upper floors inside the busy band
+#define BAND_STEPS 1500  // Steps before the band moves
+
+// upperFloor: a random floor above the lobby, usually inside the band starting at band_lo
+static int upperFloor(unsigned int *seed, int top_floor, int band_lo, int band_size)
+{
+    if ((int)(rand_r(seed) % 100) < BAND_PERCENT)
+        return band_lo + rand_r(seed) % band_size;
+    return LOBBY + 1 + rand_r(seed) % (top_floor - LOBBY);
+}
+
+// shiftingTraffic: passengers arriving at per_thousand per step, sorted by arrival
+static void shiftingTraffic(SimPassenger *passengers, int count, int top_floor, int per_thousand)
+{
+    unsigned int seed = 1;
+    int band_size = (top_floor - LOBBY) / 5 > 0 ? (top_floor - LOBBY) / 5 : 1;
+    int band_lo = LOBBY + 1;
+    int step = 0;
+    int made = 0;
+    while (made < count)
+    {
+        if (step % BAND_STEPS == 0)
+            band_lo = LOBBY + 1 + rand_r(&seed) % (top_floor - LOBBY - band_size + 1);
+
+        if ((int)(rand_r(&seed) % 1000) < per_thousand)
+        {
+            SimPassenger *p = &passengers[made++];
+            p->arrival = step;
+            int upper = upperFloor(&seed, top_floor, band_lo, band_size);
+            if ((int)(rand_r(&seed) % 100) < LOBBY_PERCENT)
+            {
+                int up = rand_r(&seed) % 2;
+                p->source = up ? LOBBY : upper;
+                p->dest = up ? upper : LOBBY;
+            }
+            else
+            {
+                p->source = upper;
+                do
+                {
+                    p->dest = upperFloor(&seed, top_floor, band_lo, band_size);
+                } while (p->dest == p->source);
+            }
+        }
+        step++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int num_cars = argc > 2 ? atoi(argv[2]) : 6;
+    int top_floor = argc > 3 ? atoi(argv[3]) : 60;
+    if (count <= 0 || num_cars <= 0 || top_floor < 6 || top_floor > 999)
+    {
+        fprintf(stderr, "Usage: %s [passengers] [cars] [top_floor]\n", argv[0]);
+        return 1;
+    }
+
+    // Dispatch logs every FLOOR it sends; keep that out of the results
+    freopen("/dev/null", "w", stdout);
+
+    SimPassenger *passengers = malloc(count * sizeof(SimPassenger));
+    fprintf(stderr, "%d passengers, %d cars, lobby 1 to floor %d, times in steps\n", count, num_cars, top_floor);
+
+    const int rates[] = {100, 250, 500};
+    for (int r = 0; r < 3; r++)
+    {
+        shiftingTraffic(passengers, count, top_floor, rates[r]);
+        fprintf(stderr, "\n%.2f arrivals per step\n", rates[r] / 1000.0);
+        simPrintHeader();
+
+        const DispatchMode modes[] = {DISPATCH_ETA, DISPATCH_ETA, DISPATCH_GROUP, DISPATCH_GROUP};
+        const int zoned[] = {0, 1, 0, 1};
+        const char *labels[] = {"eta", "eta zones", "group", "group zones"};
+        for (int m = 0; m < 4; m++)
+        {
+            dispatch_mode = modes[m];
+            zoning_enabled = zoned[m];
+            SimConfig config = {num_cars, LOBBY, top_floor, 0};
+            SimResult result;
+            simRun(&config, passengers, count, &result);
+            simPrintResult(labels[m], &result);
+        }
+    }
+
+    free(passengers);
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "zoning.h"
+#include "traffic.h"
+#include "parking.h"
+#include "latency.h"
+#include "fleet-sim.h"
+
+#define FAKE_SOCKFD_BASE 1000 // Cars are looked up by socket; these never touch the network
+#define MAX_SIM_CARS 64
+#define IDLE_LIMIT 100000 // Steps after the last arrival before giving up on the fleet
+#define STEP_MS 100       // What a step stands for on traffic.c's clock, as ./car ... 100
+
+typedef struct
+{
+    CarStatus status;
+    int current;
+    int target;    // Last FLOOR from the controller
+    int reopen;    // FLOOR for the floor it is closed at
+    int openings;  // Door openings so far
+    long floors;   // Floors travelled so far
+} SimCar;
+
+static SimCar sim_cars[MAX_SIM_CARS];
+static int sim_num_cars;
+static int sim_step;
+
+// simClock: the simulation's time, for the traffic classifier and parking
+static long simClock(void)
+{
+    return (long)sim_step * STEP_MS;
+}
+
+// simClockUs: the same, in microseconds for the latency histograms
+static long simClockUs(void)
+{
+    return simClock() * 1000;
+}
+
+// sendFloorToCar: hand the FLOOR straight to the simulated car, as car.c would take it
+void sendFloorToCar(Car *car, int floor)
+{
+    SimCar *sim = &sim_cars[car->sockfd - FAKE_SOCKFD_BASE];
+    sim->target = floor;
+    if (floor == sim->current && sim->status == CAR_CLOSED)
+    {
+        sim->reopen = 1;
+    }
+}
+
+// stepCar: advance one car by one step. Returns 1 if its doors started opening.
+static int stepCar(int index)
+{
+    SimCar *sim = &sim_cars[index];
+    CarStatus before = sim->status;
+
+    switch (sim->status)
+    {
+    case CAR_CLOSED:
+        if (sim->target != sim->current)
+        {
+            sim->current += sim->target > sim->current ? 1 : -1;
+            sim->floors++;
+            sim->status = sim->current == sim->target ? CAR_OPENING : CAR_BETWEEN;
+        }
+        else if (sim->reopen)
+        {
+            sim->status = CAR_OPENING;
+        }
+        sim->reopen = 0;
+        break;
+    case CAR_BETWEEN:
+        sim->current += sim->target > sim->current ? 1 : -1;
+        sim->floors++;
+        if (sim->current == sim->target)
+            sim->status = CAR_OPENING;
+        break;
+    case CAR_OPENING:
+        sim->status = CAR_OPEN;
+        break;
+    case CAR_OPEN:
+        sim->status = CAR_CLOSING;
+        break;
+    default:
+        sim->status = CAR_CLOSED;
+        break;
+    }
+
+    if (sim->status == before && sim->status != CAR_BETWEEN)
+        return 0;
+
+    // The controller may answer Opening with the next FLOOR, which lands in sim->target
+    updateCarStatus(FAKE_SOCKFD_BASE + index, sim->status, sim->current, sim->target);
+    if (sim->status == CAR_OPENING)
+    {
+        sim->openings++;
+        return 1;
+    }
+    return 0;
+}
+
+// carIndex: simulated car behind a name from assignCall()
+static int carIndex(const char *name)
+{
+    int index = -1;
+    sscanf(name, "Car%d", &index);
+    return index;
+}
+
+static int compareInts(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+void simRun(const SimConfig *config, SimPassenger *passengers, int count, SimResult *result)
+{
+    registryInit();
+    dispatchInit();
+    zoningInit();
+    sim_step = 0;
+    if (traffic_adaptive)
+    {
+        traffic_clock = simClock;
+        trafficInit();
+    }
+    parking_clock = simClock;
+    latency_clock = simClockUs;
+    parkingInit();
+    sim_num_cars = config->num_cars < MAX_SIM_CARS ? config->num_cars : MAX_SIM_CARS;
+
+    char lowest[8], highest[8];
+    int_to_floor(config->lowest_floor, lowest);
+    int_to_floor(config->highest_floor, highest);
+    for (int i = 0; i < sim_num_cars; i++)
+    {
+        // Start spread out over the building
+        int home = config->lowest_floor +
+                   (config->highest_floor - config->lowest_floor) * i / (sim_num_cars > 1 ? sim_num_cars : 1);
+        char name[50];
+        sprintf(name, "Car%d", i);
+        handleCarRegistration(name, lowest, highest, FAKE_SOCKFD_BASE + i, NULL);
+        sim_cars[i] = (SimCar){CAR_CLOSED, home, home, 0, 0, 0};
+        updateCarStatus(FAKE_SOCKFD_BASE + i, CAR_CLOSED, home, home);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        passengers[i].car = -1;
+        passengers[i].picked_up = -1;
+        passengers[i].delivered = -1;
+    }
+
+    BatchCall *window = malloc((count > 0 ? count : 1) * sizeof(BatchCall));
+    int *window_passenger = malloc((count > 0 ? count : 1) * sizeof(int));
+    int window_count = 0;
+    int window_opened = 0;
+
+    // Passengers assigned to a car and not yet delivered, in no particular order
+    int *open = malloc((count > 0 ? count : 1) * sizeof(int));
+    int num_open = 0;
+
+    int next = 0;
+    int last_arrival = count > 0 ? passengers[count - 1].arrival : 0;
+    int step;
+    for (step = 0; step < last_arrival + IDLE_LIMIT; step++)
+    {
+        sim_step = step;
+        // New calls
+        for (; next < count && passengers[next].arrival <= step; next++)
+        {
+            SimPassenger *p = &passengers[next];
+            if (config->batch_window == 0)
+            {
+                char car_name[50];
+                if (assignCall(p->source, p->dest, car_name) == 0)
+                {
+                    p->car = carIndex(car_name);
+                    open[num_open++] = next;
+                }
+                continue;
+            }
+            if (window_count == 0)
+                window_opened = step;
+            window[window_count] = (BatchCall){p->source, p->dest, "", latency_clock()};
+            window_passenger[window_count++] = next;
+        }
+        if (window_count > 0 && step - window_opened >= config->batch_window)
+        {
+            assignBatch(window, window_count);
+            for (int i = 0; i < window_count; i++)
+            {
+                if (window[i].car_name[0] != '\0')
+                {
+                    passengers[window_passenger[i]].car = carIndex(window[i].car_name);
+                    open[num_open++] = window_passenger[i];
+                }
+            }
+            window_count = 0;
+        }
+
+        // Move the cars and let passengers off and on wherever doors open
+        int busy = (next < count || window_count > 0);
+        for (int c = 0; c < sim_num_cars; c++)
+        {
+            if (stepCar(c))
+            {
+                int floor = sim_cars[c].current;
+                for (int k = 0; k < num_open; k++)
+                {
+                    SimPassenger *p = &passengers[open[k]];
+                    if (p->car != c)
+                        continue;
+                    if (p->picked_up != -1 && p->dest == floor)
+                    {
+                        p->delivered = step;
+                        open[k--] = open[--num_open];
+                    }
+                    else if (p->picked_up == -1 && p->source == floor)
+                    {
+                        p->picked_up = step;
+                    }
+                }
+            }
+            Car *car = findCarBySocket(FAKE_SOCKFD_BASE + c);
+            if (sim_cars[c].status != CAR_CLOSED || sim_cars[c].target != sim_cars[c].current ||
+                stopSetCount(&car->stops) > 0)
+            {
+                busy = 1;
+            }
+        }
+        if (!busy)
+            break;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->passengers = count;
+    result->steps = step;
+
+    int *waits = malloc((count > 0 ? count : 1) * sizeof(int));
+    int delivered = 0;
+    long wait_total = 0, journey_total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        SimPassenger *p = &passengers[i];
+        if (p->car == -1)
+        {
+            result->unassigned++;
+        }
+        else if (p->delivered == -1)
+        {
+            result->stranded++;
+        }
+        else
+        {
+            waits[delivered++] = p->picked_up - p->arrival;
+            wait_total += p->picked_up - p->arrival;
+            journey_total += p->delivered - p->arrival;
+        }
+    }
+
+    int openings = 0;
+    long floors = 0;
+    for (int c = 0; c < sim_num_cars; c++)
+    {
+        openings += sim_cars[c].openings;
+        floors += sim_cars[c].floors;
+    }
+
+    if (delivered > 0)
+    {
+        qsort(waits, delivered, sizeof(int), compareInts);
+        result->mean_wait = (double)wait_total / delivered;
+        result->p95_wait = waits[(delivered * 95) / 100 < delivered ? (delivered * 95) / 100 : delivered - 1];
+        result->mean_journey = (double)journey_total / delivered;
+        result->stops_per_trip = (double)openings / delivered;
+        result->floors_per_trip = (double)floors / delivered;
+    }
+
+    free(waits);
+    free(window);
+    free(window_passenger);
+    free(open);
+}
+
+void simPrintHeader(void)
+{
+    fprintf(stderr, "%-12s  %6s  %9s  %8s  %12s  %10s  %11s  %8s  %6s  %9s\n", "mode", "riders", "mean wait",
+            "p95 wait", "mean journey", "stops/trip", "floors/trip", "stranded", "steps", "per 100");
+}
+
+void simPrintResult(const char *label, const SimResult *result)
+{
+    // Handling capacity: passengers delivered per 100 steps
+    int delivered = result->passengers - result->unassigned - result->stranded;
+    fprintf(stderr, "%-12s  %6d  %9.1f  %8.0f  %12.1f  %10.2f  %11.1f  %8d  %6d  %9.1f\n", label,
+            result->passengers - result->unassigned, result->mean_wait, result->p95_wait,
+            result->mean_journey, result->stops_per_trip, result->floors_per_trip, result->stranded, result->steps,
+            result->steps > 0 ? delivered * 100.0 / result->steps : 0.0);
+}
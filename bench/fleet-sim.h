@@ -0,0 +1,53 @@
+#ifndef FLEET_SIM_H
+#define FLEET_SIM_H
+
+// Step-by-step simulation of a fleet of cars driven by the controller's own
+// dispatch code (registry.c, dispatch.c), for comparing dispatch modes on
+// the same passengers. No sockets: FLOOR messages go straight to the
+// simulated car, and STATUS updates straight to updateCarStatus().
+//
+// One step is one car delay: a car moves one floor per step and spends one
+// step each Opening, Open and Closing at a stop, like car.c. The
+// controller's logging goes to stdout; benchmarks send it to /dev/null.
+
+typedef struct
+{
+    int arrival; // Step the passenger presses the call button
+    int source;
+    int dest;
+
+    // Set by simRun()
+    int car;       // Car the call went to, -1 if none
+    int picked_up; // Step the car opened for them at source, -1 if never
+    int delivered; // Step the car opened at dest with them aboard, -1 if never
+} SimPassenger;
+
+typedef struct
+{
+    int num_cars;
+    int lowest_floor; // Every car serves lowest to highest
+    int highest_floor;
+    int batch_window; // Steps calls are held and assigned together, 0 to assign each on arrival
+} SimConfig;
+
+typedef struct
+{
+    int passengers;
+    int unassigned; // No car could take the call
+    int stranded;   // Assigned but never delivered, e.g. a merged stop passed before pickup
+    double mean_wait;    // Arrival to pickup, delivered passengers only
+    double p95_wait;
+    double mean_journey; // Arrival to delivery
+    double stops_per_trip; // Door openings per delivered passenger
+    double floors_per_trip; // Floors the fleet travelled per delivered passenger
+    int steps;           // Until the last car was idle
+} SimResult;
+
+// simRun: run passengers (sorted by arrival) through a fresh fleet until every car is idle
+void simRun(const SimConfig *config, SimPassenger *passengers, int count, SimResult *result);
+
+// simPrintHeader / simPrintResult: one table row per run
+void simPrintHeader(void);
+void simPrintResult(const char *label, const SimResult *result);
+
+#endif
@@ -1,5 +1,6 @@
 // Call program - requests elevator service from a floor
 // Usage: ./call <source_floor> <destination_floor>
+//        ./call --session   (one connection, "<source> <destination>" per line on stdin)
 // Example: ./call 1 5     - Call elevator from floor 1 to floor 5
 //         ./call B2 1    - Call elevator from basement 2 to floor 1
 
@@ -10,21 +11,13 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include "frame.h"
+#include "endpoint.h"
 
-#define CONTROLLER_PORT 3000
-#define CONTROLLER_IP "127.0.0.1"
-
-// sendMessage: send a 16-bit length prefix followed by the message bytes
-void sendMessage(int sockfd, const char *msg)
-{
-    uint16_t len = strlen(msg);
-    uint16_t net_len = htons(len);
-    send(sockfd, &net_len, sizeof(net_len), 0);
-    send(sockfd, msg, len, 0);
-}
 
 // is_floor_valid: validate floor strings (B1..B99, 1..999)
 bool is_floor_valid(const char *floor_str)
@@ -61,21 +54,215 @@ bool is_floor_valid(const char *floor_str)
     return false;
 }
 
-// receiveMessage: read a length-prefixed message into buffer
-void receiveMessage(int sockfd, char *buffer, int buffer_size)
+// printArrival: report the cars in a CAR reply's car list - one name, or a trip in legs
+// such as "Alpha 20 Beta" (Alpha, then change at floor 20 to Beta)
+void printArrival(const char *cars)
 {
-    uint16_t len;
-    recv(sockfd, &len, sizeof(len), 0); // Receive the length first
-    len = ntohs(len);                   // Convert length back to host byte order
+    char name[50], floor[4];
+    int used;
+    if (sscanf(cars, "%49s%n", name, &used) != 1)
+    {
+        return;
+    }
+    printf("CAR %s is arriving.", name);
+    cars += used;
+    while (sscanf(cars, "%3s %49s%n", floor, name, &used) == 2)
+    {
+        printf(" Change at floor %s to CAR %s.", floor, name);
+        cars += used;
+    }
+    printf("\n");
+}
 
-    if (len >= buffer_size)
+// receiveMessage: block until one whole length-prefixed message has arrived,
+// however the bytes are split across reads. Returns -1 if the connection ends first.
+int receiveMessage(int sockfd, FrameDecoder *dec, FrameView *frame)
+{
+    int got;
+    while ((got = frameNext(dec, frame)) == 0)
+    {
+        int result = frameRead(dec, sockfd, 0);
+        if (result == FRAME_CLOSED || result == FRAME_ERROR)
+        {
+            return -1;
+        }
+    }
+    if (got < 0)
     {
         fprintf(stderr, "Received message is too large for buffer\n");
-        exit(1);
+        return -1;
+    }
+    return 0;
+}
+
+// connectToController: connect over TCP or a Unix-domain socket, as $CONTROLLER_ENDPOINT says.
+// Returns -1 if the controller isn't there.
+int connectToController(void)
+{
+    return endpointConnect(controllerEndpoint());
+}
+
+// ---------------------Session Mode---------------------
+
+// A call sent on the session and not yet answered; its id is its index + 1
+typedef struct
+{
+    char source[4];
+    char destination[4];
+} SessionCall;
+
+SessionCall *session_calls = NULL;
+int num_session_calls = 0;
+int session_capacity = 0;
+
+// sendSessionCall: validate one "<source> <destination>" line and send it as a tagged CALL.
+// Returns 1 if a call was sent (and now awaits a reply), 0 otherwise.
+int sendSessionCall(int sockfd, const char *line)
+{
+    char source[16], destination[16];
+    if (sscanf(line, "%15s %15s", source, destination) != 2)
+    {
+        return 0; // Blank line
+    }
+    if (!is_floor_valid(source) || !is_floor_valid(destination))
+    {
+        printf("%s -> %s: Invalid floor(s) specified.\n", source, destination);
+        return 0;
+    }
+    if (strcmp(source, destination) == 0)
+    {
+        printf("%s -> %s: You are already on that floor!\n", source, destination);
+        return 0;
+    }
+
+    if (num_session_calls == session_capacity)
+    {
+        session_capacity = session_capacity ? session_capacity * 2 : 16;
+        session_calls = realloc(session_calls, session_capacity * sizeof(SessionCall));
     }
+    SessionCall *call = &session_calls[num_session_calls++];
+    strcpy(call->source, source);
+    strcpy(call->destination, destination);
 
-    recv(sockfd, buffer, len, 0);
-    buffer[len] = '\0'; // Null-terminate the received string
+    char message_buffer[100];
+    sprintf(message_buffer, "CALL %d %s %s", num_session_calls, source, destination);
+    frameSend(sockfd, message_buffer, 0);
+    return 1;
+}
+
+// printSessionReply: match a tagged reply to its call and report it.
+// Returns 1 if it answered a call, 0 otherwise.
+int printSessionReply(const char *reply)
+{
+    int id, used;
+    char car_name[50];
+    if (sscanf(reply, "CAR %d %n%49s", &id, &used, car_name) == 2 && id >= 1 && id <= num_session_calls)
+    {
+        SessionCall *call = &session_calls[id - 1];
+        printf("%s -> %s: ", call->source, call->destination);
+        printArrival(reply + used);
+        return 1;
+    }
+    if (sscanf(reply, "UNAVAILABLE %d", &id) == 1 && id >= 1 && id <= num_session_calls)
+    {
+        SessionCall *call = &session_calls[id - 1];
+        printf("%s -> %s: Sorry, no car is available to take this request.\n", call->source, call->destination);
+        return 1;
+    }
+    printf("%s\n", reply);
+    return strncmp(reply, "ERROR", 5) == 0; // A rejected call gets no other reply
+}
+
+// runSession: send every call read from stdin over one connection without waiting
+// for earlier replies, printing the replies in whatever order they come back
+int runSession(void)
+{
+    int sockfd = connectToController();
+    if (sockfd == -1)
+    {
+        printf("Unable to connect to elevator system.\n");
+        return 1;
+    }
+
+    FrameDecoder decoder;
+    FrameView reply;
+    frameDecoderInit(&decoder);
+    frameSend(sockfd, "SESSION", 0);
+    if (receiveMessage(sockfd, &decoder, &reply) != 0 || strcmp(reply.data, "SESSION OK") != 0)
+    {
+        printf("Elevator system does not support call sessions.\n");
+        close(sockfd);
+        return 1;
+    }
+
+    // stdin is read in raw chunks so poll() never misses lines hidden in a stdio buffer
+    char input[1024];
+    size_t input_len = 0;
+    int input_open = 1;
+    int outstanding = 0;
+
+    while (input_open || outstanding > 0)
+    {
+        struct pollfd fds[2] = {
+            {sockfd, POLLIN, 0},
+            {input_open ? STDIN_FILENO : -1, POLLIN, 0},
+        };
+        if (poll(fds, 2, -1) == -1)
+        {
+            perror("poll");
+            break;
+        }
+
+        if (fds[1].revents)
+        {
+            ssize_t n = read(STDIN_FILENO, input + input_len, sizeof(input) - 1 - input_len);
+            if (n <= 0)
+            {
+                input_open = 0;
+                n = 0;
+                if (input_len > 0)
+                {
+                    input[input_len++] = '\n'; // Last line had no newline
+                }
+            }
+            input_len += n;
+
+            // Send every complete line, keep a partial one for the next read
+            char *start = input;
+            char *newline;
+            while ((newline = memchr(start, '\n', input + input_len - start)) != NULL)
+            {
+                *newline = '\0';
+                outstanding += sendSessionCall(sockfd, start);
+                start = newline + 1;
+            }
+            input_len = input + input_len - start;
+            memmove(input, start, input_len);
+            if (input_len == sizeof(input) - 1)
+            {
+                input_len = 0; // Line too long to be a call, discard it
+            }
+        }
+
+        if (fds[0].revents)
+        {
+            int result = frameRead(&decoder, sockfd, 0);
+            if (result == FRAME_CLOSED || result == FRAME_ERROR)
+            {
+                printf("Lost connection to elevator system.\n");
+                close(sockfd);
+                return 1;
+            }
+            while (frameNext(&decoder, &reply) == 1)
+            {
+                outstanding -= printSessionReply(reply.data);
+            }
+        }
+    }
+
+    close(sockfd);
+    free(session_calls);
+    return 0;
 }
 
 // ---------------------Main Function---------------------
@@ -84,9 +271,14 @@ void receiveMessage(int sockfd, char *buffer, int buffer_size)
 int main(int argc, char *argv[])
 {
     // 1. Check arguments
+    if (argc == 2 && strcmp(argv[1], "--session") == 0)
+    {
+        return runSession();
+    }
     if (argc != 3)
     {
         fprintf(stderr, "Usage: %s <source_floor> <destination_floor>\n", argv[0]);
+        fprintf(stderr, "       %s --session\n", argv[0]);
         return 1;
     }
 
@@ -106,43 +298,38 @@ int main(int argc, char *argv[])
         return 0;
     }
 
-    // 2. Create a TCP socket
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-
+    // 2. Connect to the controller
+    int sockfd = connectToController();
     if (sockfd == -1)
     {
-        perror("socket");
+        printf("Unable to connect to elevator system.\n");
         return 1;
     }
 
-    // 3. Set up the server's address struct
-    struct sockaddr_in server_address;
-    memset(&server_address, 0, sizeof(server_address));
-    server_address.sin_family = AF_INET;
-    server_address.sin_port = htons(CONTROLLER_PORT);
-    inet_pton(AF_INET, CONTROLLER_IP, &server_address.sin_addr);
+    // 3. Build and send the message
+    char message_buffer[100];
+    sprintf(message_buffer, "CALL %s %s", source_floor, destination_floor);
+    frameSend(sockfd, message_buffer, 0);
 
-    // 4. Connect to the server
-    if (connect(sockfd, (struct sockaddr *)&server_address, sizeof(server_address)) == -1)
+    // 4. Wait for and receive the reply
+    FrameDecoder decoder;
+    FrameView reply;
+    frameDecoderInit(&decoder);
+    if (receiveMessage(sockfd, &decoder, &reply) != 0)
     {
-        printf("Unable to connect to elevator system.\n");
+        printf("Lost connection to elevator system.\n");
         close(sockfd);
         return 1;
     }
 
-    // 5. Build and send the message
-    char message_buffer[100];
-    sprintf(message_buffer, "CALL %s %s", source_floor, destination_floor);
-    sendMessage(sockfd, message_buffer);
-
-    // 6. Wait for and receive the reply
-    char reply_buffer[200];
-    receiveMessage(sockfd, reply_buffer, sizeof(reply_buffer));
-
-    // 7. Process the reply
-    if (strcmp(reply_buffer, "UNAVAILABLE") != 0)
+    // 5. Process the reply
+    if (strncmp(reply.data, "CAR ", 4) == 0)
+    {
+        printArrival(reply.data + 4);
+    }
+    else if (strcmp(reply.data, "UNAVAILABLE") != 0)
     {
-        printf("%s is arriving.\n", reply_buffer);
+        printf("%s is arriving.\n", reply.data);
     }
     else
     {
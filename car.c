@@ -12,12 +12,16 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include "shared.h"
+#include "frame.h"
+#include "protocol.h"
+#include "endpoint.h"
+#include "lockstat.h"
+#include <poll.h>
 #include <time.h>
 #include <errno.h>
 
-#define CONTROLLER_PORT 3000
-#define CONTROLLER_IP "127.0.0.1"
 #define BUFFER_SIZE 1024
+#define PROTOCOL_WAIT_MS 500 // How long to wait for the controller to accept the binary protocol
 
 // Global variable for signal handler
 char *g_shm_name = NULL;
@@ -85,6 +89,7 @@ typedef struct
     char *lowest_floor_str;  // Lowest floor car can reach
     char *highest_floor_str; // Highest floor car can reach
     int delay;               // Delay between status updates (ms)
+    int binary;              // Offer the binary protocol when registering
 } network_thread_args;
 
 // safety_monitor_args: data needed for safety monitoring thread
@@ -96,6 +101,113 @@ typedef struct
     int sockfd;                 // Socket to close on disconnect
 } safety_monitor_args;
 
+// ControllerLink: one connection to the controller and the protocol agreed on it
+typedef struct
+{
+    int sockfd;
+    int protocol;     // PROTOCOL_TEXT or PROTOCOL_BINARY
+    uint16_t out_seq; // Sequence number of the next binary message
+    FrameDecoder decoder;
+} ControllerLink;
+
+// sendStatus: report the car's status in the link's protocol
+int sendStatus(ControllerLink *link, const char *status, const char *current, const char *destination)
+{
+    if (link->protocol == PROTOCOL_BINARY)
+    {
+        uint8_t payload[V2_MESSAGE_SIZE];
+        V2Message msg = {V2_STATUS, carStatusFromName(status), link->out_seq++,
+                         floor_to_int(current), floor_to_int(destination)};
+        return frameSendBytes(link->sockfd, payload, encodeV2(payload, &msg), 0);
+    }
+
+    char status_message[BUFFER_SIZE];
+    sprintf(status_message, "STATUS %s %s %s", status, current, destination);
+    return frameSend(link->sockfd, status_message, 0);
+}
+
+// sendNotice: INDIVIDUAL SERVICE or EMERGENCY, in the link's protocol
+void sendNotice(ControllerLink *link, uint8_t type, const char *text)
+{
+    if (link->protocol == PROTOCOL_BINARY)
+    {
+        uint8_t payload[V2_MESSAGE_SIZE];
+        V2Message msg = {type, 0, link->out_seq++, 0, 0};
+        frameSendBytes(link->sockfd, payload, encodeV2(payload, &msg), 0);
+    }
+    else
+    {
+        frameSend(link->sockfd, text, 0);
+    }
+}
+
+// handleFloor: the controller has sent the car to floor
+void handleFloor(car_shared_mem *shm_ptr, const char *floor)
+{
+    LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
+    strncpy(shm_ptr->destination_floor, floor, sizeof(shm_ptr->destination_floor) - 1);
+    shm_ptr->destination_floor[sizeof(shm_ptr->destination_floor) - 1] = '\0';
+    if (strcmp(shm_ptr->current_floor, floor) == 0 && strcmp(shm_ptr->status, "Closed") == 0)
+    {
+        shm_ptr->open_button = 1;
+    }
+    pthread_cond_broadcast(&shm_ptr->cond);
+    lockstatUnlock(&shm_ptr->mutex);
+}
+
+// handleControllerFrame: act on one message from the controller.
+// Returns -1 if it can't be understood and the connection should be dropped.
+int handleControllerFrame(ControllerLink *link, car_shared_mem *shm_ptr, const FrameView *frame)
+{
+    if (link->protocol == PROTOCOL_BINARY)
+    {
+        V2Message msg;
+        if (decodeV2((const uint8_t *)frame->data, frame->len, &msg) != 0)
+        {
+            return -1;
+        }
+        if (msg.type == V2_FLOOR)
+        {
+            char floor[8];
+            int_to_floor(msg.floor, floor);
+            printf("Received from controller: [FLOOR %s]\n", floor);
+            handleFloor(shm_ptr, floor);
+        }
+        return 0;
+    }
+
+    printf("Received from controller: [%s]\n", frame->data);
+    if (strncmp(frame->data, "FLOOR ", 6) == 0)
+    {
+        handleFloor(shm_ptr, frame->data + 6);
+    }
+    return 0;
+}
+
+// negotiateProtocol: after offering the binary protocol, wait briefly for the controller to accept.
+// A controller that doesn't know it never replies, so the link stays on text; anything else it
+// does send in the meantime is handled as usual.
+void negotiateProtocol(ControllerLink *link, car_shared_mem *shm_ptr)
+{
+    struct pollfd pfd = {link->sockfd, POLLIN, 0};
+    if (poll(&pfd, 1, PROTOCOL_WAIT_MS) <= 0 || frameRead(&link->decoder, link->sockfd, 0) != FRAME_OK)
+    {
+        return;
+    }
+
+    FrameView frame;
+    while (frameNext(&link->decoder, &frame) == 1)
+    {
+        if (link->protocol == PROTOCOL_TEXT && strcmp(frame.data, PROTOCOL_ACCEPT) == 0)
+        {
+            printf("Controller accepted the binary protocol.\n");
+            link->protocol = PROTOCOL_BINARY;
+            continue;
+        }
+        handleControllerFrame(link, shm_ptr, &frame);
+    }
+}
+
 // network_thread_function: maintains controller connection and forwards STATUS/FLOOR messages
 void *network_thread_function(void *args)
 {
@@ -106,80 +218,70 @@ void *network_thread_function(void *args)
     while (1) // Outer reconnection loop
     {
         // Wait if in service/emergency mode
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         while (shm_ptr->individual_service_mode == 1 || shm_ptr->emergency_mode == 1 || shm_ptr->safety_system == 0)
         {
             struct timespec ts;
             ts.tv_nsec += (delay_ms * 1000000L);
             ts.tv_sec += ts.tv_nsec / 1000000000L;
             ts.tv_nsec = ts.tv_nsec % 1000000000L;
-            pthread_cond_timedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
+            lockstatCondTimedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
         }
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
 
-        // Try to connect (with retries)
+        // Try to connect (with retries), over TCP or a Unix-domain socket as $CONTROLLER_ENDPOINT says
         int sockfd;
         while (1)
         {
-            sockfd = socket(AF_INET, SOCK_STREAM, 0);
-            if (sockfd == -1)
-            {
-                perror("socket");
-                sleep(1);
-                continue;
-            }
-
-            struct sockaddr_in server_address;
-            memset(&server_address, 0, sizeof(server_address));
-            server_address.sin_family = AF_INET;
-            server_address.sin_port = htons(CONTROLLER_PORT);
-            inet_pton(AF_INET, CONTROLLER_IP, &server_address.sin_addr);
-
-            if (connect(sockfd, (struct sockaddr *)&server_address, sizeof(server_address)) == 0)
+            sockfd = endpointConnect(controllerEndpoint());
+            if (sockfd != -1)
             {
                 printf("Car '%s' connected to controller.\n", thread_args->car_name);
                 break; // Connected successfully
             }
 
             printf("Car '%s' failed to connect. Retrying in %dms...\n", thread_args->car_name, delay_ms);
-            close(sockfd);
             usleep(delay_ms * 1000);
         }
 
+        ControllerLink link;
+        link.sockfd = sockfd;
+        link.protocol = PROTOCOL_TEXT;
+        link.out_seq = 0;
+        frameDecoderInit(&link.decoder); // Messages from the controller, possibly several per read
+
         // Send registration message
         char message_buffer[BUFFER_SIZE];
-        sprintf(message_buffer, "CAR %s %s %s",
+        sprintf(message_buffer, "CAR %s %s %s%s",
                 thread_args->car_name,
                 thread_args->lowest_floor_str,
-                thread_args->highest_floor_str);
+                thread_args->highest_floor_str,
+                thread_args->binary ? " " PROTOCOL_OFFER : "");
 
-        uint16_t len = strlen(message_buffer);
-        uint16_t net_len = htons(len);
-        send(sockfd, &net_len, sizeof(net_len), 0);
-        send(sockfd, message_buffer, len, 0);
+        frameSend(sockfd, message_buffer, 0);
         printf("Registered with controller: [%s]\n", message_buffer);
+        if (thread_args->binary)
+        {
+            negotiateProtocol(&link, shm_ptr);
+        }
 
         // Signal that we're now monitoring the safety watchdog
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->safety_system = 2; // Set to 2 to indicate network thread is monitoring
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
 
         // Send initial STATUS with fresh state
         usleep(50 * 1000); // Wait 50ms for any transitions to complete
 
-        pthread_mutex_lock(&shm_ptr->mutex);
-        char status_message[BUFFER_SIZE];
-        sprintf(status_message, "STATUS %s %s %s",
-                shm_ptr->status,
-                shm_ptr->current_floor,
-                shm_ptr->destination_floor);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
+        char status[8], current[4], destination[4];
+        strcpy(status, shm_ptr->status);
+        strcpy(current, shm_ptr->current_floor);
+        strcpy(destination, shm_ptr->destination_floor);
+        lockstatUnlock(&shm_ptr->mutex);
 
-        len = strlen(status_message);
-        net_len = htons(len);
-        send(sockfd, &net_len, sizeof(net_len), 0);
-        send(sockfd, status_message, len, 0);
+        sendStatus(&link, status, current, destination);
 
         // Set socket to non-blocking
         int flags = fcntl(sockfd, F_GETFL, 0);
@@ -187,7 +289,7 @@ void *network_thread_function(void *args)
 
         // Main communication loop
         int should_disconnect = 0;
-        char last_status_sent[BUFFER_SIZE] = ""; // Keep track of last sent message
+        char last_status[8] = "", last_current[4] = "", last_destination[4] = ""; // Last status sent
         while (!should_disconnect)
         {
             // Use timedwait to prevent race conditions. This waits for the delay OR a signal.
@@ -197,31 +299,23 @@ void *network_thread_function(void *args)
             ts.tv_sec += nsec / 1000000000L;
             ts.tv_nsec = nsec % 1000000000L;
 
-            pthread_mutex_lock(&shm_ptr->mutex);
-            pthread_cond_timedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
+            LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
+            lockstatCondTimedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
 
             // Check for disconnect conditions *after* waiting
             if (shm_ptr->individual_service_mode == 1)
             {
-                pthread_mutex_unlock(&shm_ptr->mutex); // Add this
+                lockstatUnlock(&shm_ptr->mutex); // Add this
                 printf("Entering individual service mode, disconnecting...\n");
-                char msg[] = "INDIVIDUAL SERVICE";
-                len = strlen(msg);
-                net_len = htons(len);
-                send(sockfd, &net_len, sizeof(net_len), 0);
-                send(sockfd, msg, len, 0);
+                sendNotice(&link, V2_INDIVIDUAL_SERVICE, "INDIVIDUAL SERVICE");
                 should_disconnect = 1;
             }
 
             else if (shm_ptr->emergency_mode == 1)
             {
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 printf("EMERGENCY\n");
-                char msg[] = "EMERGENCY";
-                len = strlen(msg);
-                net_len = htons(len);
-                send(sockfd, &net_len, sizeof(net_len), 0);
-                send(sockfd, msg, len, 0);
+                sendNotice(&link, V2_EMERGENCY, "EMERGENCY");
                 close(sockfd);
                 should_disconnect = 1;
                 break;
@@ -229,24 +323,19 @@ void *network_thread_function(void *args)
 
             if (should_disconnect)
             {
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 continue;
             }
 
-            // Prepare the status message
-            sprintf(status_message, "STATUS %s %s %s",
-                    shm_ptr->status,
-                    shm_ptr->current_floor,
-                    shm_ptr->destination_floor);
-
             // Only send the status if it has changed
-            if (strcmp(status_message, last_status_sent) != 0)
+            if (strcmp(shm_ptr->status, last_status) != 0 ||
+                strcmp(shm_ptr->current_floor, last_current) != 0 ||
+                strcmp(shm_ptr->destination_floor, last_destination) != 0)
             {
-                strcpy(last_status_sent, status_message);
-                len = strlen(status_message);
-                net_len = htons(len);
-                if (send(sockfd, &net_len, sizeof(net_len), 0) == -1 ||
-                    send(sockfd, status_message, len, 0) == -1)
+                strcpy(last_status, shm_ptr->status);
+                strcpy(last_current, shm_ptr->current_floor);
+                strcpy(last_destination, shm_ptr->destination_floor);
+                if (sendStatus(&link, last_status, last_current, last_destination) == -1)
                 {
                     printf("Failed to send status, disconnecting...\n");
                     should_disconnect = 1;
@@ -259,67 +348,29 @@ void *network_thread_function(void *args)
                 shm_ptr->safety_system = 1; // Reset to 1, not 2
             }
 
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
 
             // Try to receive messages from controller (non-blocking)
-            uint16_t msg_len_network;
-            ssize_t bytes_received = recv(sockfd, &msg_len_network, sizeof(msg_len_network), MSG_DONTWAIT);
-
-            if (bytes_received == sizeof(msg_len_network))
+            int result = frameRead(&link.decoder, sockfd, MSG_DONTWAIT);
+            if (result == FRAME_CLOSED || result == FRAME_ERROR)
             {
-                uint16_t msg_len = ntohs(msg_len_network);
-                char recv_buffer[BUFFER_SIZE];
+                should_disconnect = 1; // Connection closed by peer
+            }
 
-                ssize_t total_received = 0;
-                while (total_received < msg_len)
+            // Handle every complete message that has arrived, keeping any partial one
+            FrameView frame;
+            int got;
+            while ((got = frameNext(&link.decoder, &frame)) == 1)
+            {
+                if (handleControllerFrame(&link, shm_ptr, &frame) != 0)
                 {
-                    ssize_t n = recv(sockfd, recv_buffer + total_received, msg_len - total_received, 0);
-                    if (n > 0)
-                    {
-                        total_received += n;
-                        continue;
-                    }
-                    if (n == 0)
-                    {
-                        /* connection closed by peer */
-                        should_disconnect = 1;
-                        break;
-                    }
-                    /* n < 0 */
-                    if (errno == EWOULDBLOCK || errno == EAGAIN)
-                    {
-                        /* No data available right now; wait a little and retry */
-                        usleep(1000);
-                        continue;
-                    }
-                    /* Other error - treat as disconnect */
-                    should_disconnect = 1;
+                    got = -1;
                     break;
                 }
-
-                if (should_disconnect)
-                    continue;
-
-                recv_buffer[total_received] = '\0';
-                printf("Received from controller: [%s]\n", recv_buffer);
-
-                if (strncmp(recv_buffer, "FLOOR ", 6) == 0)
-                {
-                    char *floor = recv_buffer + 6;
-                    pthread_mutex_lock(&shm_ptr->mutex);
-                    strncpy(shm_ptr->destination_floor, floor, sizeof(shm_ptr->destination_floor) - 1);
-                    shm_ptr->destination_floor[sizeof(shm_ptr->destination_floor) - 1] = '\0';
-                    if (strcmp(shm_ptr->current_floor, floor) == 0 && strcmp(shm_ptr->status, "Closed") == 0)
-                    {
-                        shm_ptr->open_button = 1;
-                    }
-                    pthread_cond_broadcast(&shm_ptr->cond);
-                    pthread_mutex_unlock(&shm_ptr->mutex);
-                }
             }
-            else if (bytes_received == 0)
+            if (got < 0)
             {
-                should_disconnect = 1; // Connection closed by peer
+                should_disconnect = 1; // Oversized or garbled message, the stream can't be trusted
             }
         }
         close(sockfd);
@@ -338,7 +389,7 @@ void *safety_monitor_thread(void *args)
     {
         usleep(delay_ms * 1000);
 
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
 
         // Only monitor when connected to controller (safety_system was set to 2 by network thread)
         if (shm_ptr->individual_service_mode == 0 &&
@@ -354,7 +405,7 @@ void *safety_monitor_thread(void *args)
                 pthread_cond_broadcast(&shm_ptr->cond);
             }
         }
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 }
 
@@ -365,9 +416,10 @@ int main(int argc, char *argv[])
     signal(SIGINT, handle_sigint);
 
     // 2. Parse arguments
-    if (argc != 5)
+    int binary = (argc == 6 && strcmp(argv[5], "--binary") == 0);
+    if (argc != 5 && !binary)
     {
-        fprintf(stderr, "Usage: %s <name> <lowest> <highest> <delay>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <name> <lowest> <highest> <delay> [--binary]\n", argv[0]);
         return 1;
     }
     char *car_name = argv[1];
@@ -375,6 +427,13 @@ int main(int argc, char *argv[])
     char *highest_floor_str = argv[3];
     int delay = atoi(argv[4]);
 
+    char lockstat_name[64];
+    snprintf(lockstat_name, sizeof(lockstat_name), "car-%s", car_name);
+    if (lockstatInit(lockstat_name) != 0)
+    {
+        perror("lockstatInit");
+    }
+
     // Convert floor bounds to integers for validation
     int lowest_floor = floor_to_int(lowest_floor_str);
     int highest_floor = floor_to_int(highest_floor_str);
@@ -431,6 +490,7 @@ int main(int argc, char *argv[])
     args->lowest_floor_str = argv[2];
     args->highest_floor_str = argv[3];
     args->delay = delay;
+    args->binary = binary;
 
     pthread_t network_thread_id, safety_thread_id;
     if (pthread_create(&network_thread_id, NULL, network_thread_function, args) != 0)
@@ -453,13 +513,13 @@ int main(int argc, char *argv[])
     printf("Car '%s' is now running. Press Ctrl+C to exit.\n", car_name);
     while (1)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
 
         // Wait if in emergency mode
         if (shm_ptr->emergency_mode == 1)
         {
-            pthread_cond_wait(&shm_ptr->cond, &shm_ptr->mutex);
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatCondWait(&shm_ptr->cond, &shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             continue;
         }
 
@@ -473,7 +533,7 @@ int main(int argc, char *argv[])
         else
         {
             // Not ready to move - wait for changes
-            pthread_cond_wait(&shm_ptr->cond, &shm_ptr->mutex);
+            lockstatCondWait(&shm_ptr->cond, &shm_ptr->mutex);
         }
 
         // Handle open button
@@ -482,17 +542,17 @@ int main(int argc, char *argv[])
             shm_ptr->open_button = 0;
             strcpy(shm_ptr->status, "Opening");
             pthread_cond_broadcast(&shm_ptr->cond);
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             usleep(delay * 1000);
 
-            pthread_mutex_lock(&shm_ptr->mutex);
+            LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
             strcpy(shm_ptr->status, "Open");
             pthread_cond_broadcast(&shm_ptr->cond);
 
             // Check if in individual service mode
             if (shm_ptr->individual_service_mode == 1)
             {
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 continue;
             }
 
@@ -502,32 +562,32 @@ int main(int argc, char *argv[])
             ts.tv_sec += nsec / 1000000000L; // ADD THIS
             ts.tv_nsec = nsec % 1000000000L; // ADD THIS
 
-            pthread_cond_timedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
+            lockstatCondTimedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
 
             if (shm_ptr->close_button == 1)
             {
                 shm_ptr->close_button = 0;
                 strcpy(shm_ptr->status, "Closing");
                 pthread_cond_broadcast(&shm_ptr->cond);
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 usleep(delay * 1000);
 
-                pthread_mutex_lock(&shm_ptr->mutex);
+                LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
                 strcpy(shm_ptr->status, "Closed");
                 pthread_cond_broadcast(&shm_ptr->cond);
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 continue;
             }
 
             strcpy(shm_ptr->status, "Closing");
             pthread_cond_broadcast(&shm_ptr->cond);
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             usleep(delay * 1000);
 
-            pthread_mutex_lock(&shm_ptr->mutex);
+            LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
             strcpy(shm_ptr->status, "Closed");
             pthread_cond_broadcast(&shm_ptr->cond);
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
         }
         // Handle close button
         else if (shm_ptr->close_button == 1)
@@ -538,17 +598,17 @@ int main(int argc, char *argv[])
             {
                 strcpy(shm_ptr->status, "Closing");
                 pthread_cond_broadcast(&shm_ptr->cond);
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 usleep(delay * 1000);
 
-                pthread_mutex_lock(&shm_ptr->mutex);
+                LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
                 strcpy(shm_ptr->status, "Closed");
                 pthread_cond_broadcast(&shm_ptr->cond);
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
             }
             else
             {
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
             }
         }
         // Handle movement
@@ -562,15 +622,15 @@ int main(int argc, char *argv[])
             {
                 strcpy(shm_ptr->destination_floor, shm_ptr->current_floor);
                 pthread_cond_broadcast(&shm_ptr->cond);
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
                 continue;
             }
 
             strcpy(shm_ptr->status, "Between");
             pthread_cond_broadcast(&shm_ptr->cond);
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             usleep(delay * 1000);
-            pthread_mutex_lock(&shm_ptr->mutex);
+            LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
             int next_floor = get_next_floor(current, destination);
             char next_floor_str[4];
             int_to_floor(next_floor, next_floor_str);
@@ -586,10 +646,10 @@ int main(int argc, char *argv[])
                     // Auto-open doors (normal mode)
                     strcpy(shm_ptr->status, "Opening");
                     pthread_cond_broadcast(&shm_ptr->cond);
-                    pthread_mutex_unlock(&shm_ptr->mutex);
+                    lockstatUnlock(&shm_ptr->mutex);
                     usleep(delay * 1000);
 
-                    pthread_mutex_lock(&shm_ptr->mutex);
+                    LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
                     strcpy(shm_ptr->status, "Open");
                     pthread_cond_broadcast(&shm_ptr->cond);
 
@@ -599,7 +659,7 @@ int main(int argc, char *argv[])
                     ts.tv_sec += nsec / 1000000000L;
                     ts.tv_nsec = nsec % 1000000000L;
 
-                    pthread_cond_timedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
+                    lockstatCondTimedwait(&shm_ptr->cond, &shm_ptr->mutex, &ts);
 
                     if (shm_ptr->close_button == 1)
                     {
@@ -608,30 +668,30 @@ int main(int argc, char *argv[])
 
                     strcpy(shm_ptr->status, "Closing");
                     pthread_cond_broadcast(&shm_ptr->cond);
-                    pthread_mutex_unlock(&shm_ptr->mutex);
+                    lockstatUnlock(&shm_ptr->mutex);
                     usleep(delay * 1000);
 
-                    pthread_mutex_lock(&shm_ptr->mutex);
+                    LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
                     strcpy(shm_ptr->status, "Closed");
                     pthread_cond_broadcast(&shm_ptr->cond);
-                    pthread_mutex_unlock(&shm_ptr->mutex);
+                    lockstatUnlock(&shm_ptr->mutex);
                 }
                 else
                 {
                     // Service mode: don't auto-open, just stay closed
                     pthread_cond_broadcast(&shm_ptr->cond);
-                    pthread_mutex_unlock(&shm_ptr->mutex);
+                    lockstatUnlock(&shm_ptr->mutex);
                 }
             } // Close the movement handler
             else
             {
-                pthread_mutex_unlock(&shm_ptr->mutex);
+                lockstatUnlock(&shm_ptr->mutex);
             }
         }
         else
         {
             // Nothing to do - unlock and loop back
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
         }
     }
     return 0; // Will not be reached
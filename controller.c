@@ -3,568 +3,1303 @@
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "batch.h"
+#include "zoning.h"
+#include "traffic.h"
+#include "parking.h"
+#include "transfer.h"
+#include "latency.h"
+#include "lockstat.h"
+#include "log.h"
+#include "frame.h"
+#include "protocol.h"
+#include "endpoint.h"
 
 #define CONTROLLER_PORT 3000
 #define BACKLOG 10
 #define BUFFER_SIZE 1024
-
-typedef struct Node
+#define MAX_EVENTS 64
+#define POOL_QUEUE_CAPACITY 64 // Accepted sockets waiting for a worker
+#define POOL_RECV_TIMEOUT 5    // Seconds a worker waits for a client's first message
+#define OUTQ_MAX_BYTES 65536   // Unsent bytes a car may fall behind by before it is dropped
+#define CAR_SNDBUF 8192        // Kernel send buffer for car sockets, the rest waits in OUTQ
+#define MAX_LISTENERS 2        // TCP, plus the Unix-domain socket with --unix
+#define MAX_BATCH_WINDOW_MS 1000
+
+// What a connection turned out to be, decided by its first message
+typedef enum
+{
+    CONN_NEW,
+    CONN_CAR,
+    CONN_CALL,   // One-shot "CALL src dst", closed after the reply
+    CONN_SESSION // Call pad sending many tagged "CALL id src dst" on one connection
+} ConnKind;
+
+// One framed message waiting to be written to a socket
+typedef struct OutFrame
 {
-    int floor;
-    struct Node *next;
-} Node;
+    struct OutFrame *next;
+    size_t len;  // Length prefix + payload
+    size_t sent; // Bytes already written
+    char data[];
+} OutFrame;
 
-typedef struct
+typedef struct Connection
 {
-    char name[50];
-    int is_active;
     int sockfd;
+    ConnKind kind;
+    char car_name[50];
+    int protocol;     // PROTOCOL_TEXT, or PROTOCOL_BINARY once a car has negotiated it
+    uint16_t in_seq;  // Next sequence number expected from a binary car
+    uint16_t out_seq; // Next sequence number to send it (under the car's lock)
+
+    // Bytes received but not yet handled
+    FrameDecoder in;
+
+    // Outbound queue. Dispatch only appends here; the thread that owns the
+    // socket (event loop or connection thread) is the only one that send()s.
+    pthread_mutex_t out_mutex;
+    OutFrame *out_head;
+    OutFrame *out_tail;
+    size_t out_bytes;
+    int out_broken;  // Fell too far behind, owner should close it
+    int close_after_send; // Batch mode one-shot call: answered, close once the reply is out
+    int wakefd;      // eventfd poked on enqueue (threaded modes), else -1
+    int on_loop;      // Owned by the event loop, which flushes what is queued here
+    int flush_queued; // Already on the event loop's flush list
+    int watched;      // In the event loop's epoll set
+    int want_write;   // Registered for EPOLLOUT (event loop mode)
+    struct Connection *next_flush;
+} Connection;
+
+// Event loop mode: connections with queued output, flushed at the end of each loop pass.
+// In --pool mode with --batch, a loop with no listeners sends held calls' replies.
+Connection *flush_list = NULL;
+pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Lets other threads (the batch window timer) wake the event loop to flush what they queued
+pthread_t loop_thread;
+int loop_wakefd = -1;
+#define LOOP_WAKE_MARKER ((Connection *)&loop_wakefd) // epoll data.ptr of loop_wakefd
+
+// Fixed set of worker threads fed by the accept loop through a bounded queue (--pool mode).
+// Short-lived CALL connections are handled entirely on a worker; car connections are
+// long-lived, so once a worker sees a CAR registration it hands the socket to its own thread.
+typedef struct
+{
+    pthread_t *threads;
+    int num_workers;
+
+    int jobs[POOL_QUEUE_CAPACITY]; // Ring buffer of accepted sockets
+    int head;
+    int count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    // Sizing statistics, reported by STATS
+    int busy;                 // Workers currently handling a connection
+    int peak_queued;          // Deepest the queue has been
+    unsigned long submitted;  // Sockets handed over by the accept loop
+    unsigned long completed;  // Sockets a worker has finished with
+    unsigned long full_waits; // Times the accept loop had to wait for space
+    double busy_seconds;      // Total time workers have spent handling connections
+    struct timespec started;
+} WorkerPool;
+
+WorkerPool pool; // num_workers == 0 unless running with --pool
+
+// Listening sockets: TCP always, and a Unix-domain socket path with --unix
+int listen_fds[MAX_LISTENERS];
+int num_listen_fds = 0;
+
+// timespecDiff: seconds elapsed from start to end
+double timespecDiff(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
 
-    int lowest_floor;
-    int highest_floor;
-
-    char current_floor[4];
-    char destination_floor[4];
-    char status[8];
+// newConnection: allocate connection state for an accepted socket
+Connection *newConnection(int sockfd)
+{
+    Connection *conn = calloc(1, sizeof(Connection));
+    conn->sockfd = sockfd;
+    conn->kind = CONN_NEW;
+    conn->protocol = PROTOCOL_TEXT;
+    conn->wakefd = -1;
+    frameDecoderInit(&conn->in);
+    pthread_mutex_init(&conn->out_mutex, NULL);
+    return conn;
+}
 
-    Node *queue;
-    int peak_floor; // Highest floor in current journey (turning point)
+// freeConnection: release a connection and anything still waiting to be sent
+void freeConnection(Connection *conn)
+{
+    OutFrame *frame = conn->out_head;
+    while (frame != NULL)
+    {
+        OutFrame *next = frame->next;
+        free(frame);
+        frame = next;
+    }
+    if (conn->wakefd != -1)
+    {
+        close(conn->wakefd);
+    }
+    pthread_mutex_destroy(&conn->out_mutex);
+    free(conn);
+}
 
-} Car;
+// scheduleFlush: put an event loop connection on the flush list, waking the loop if it may be waiting
+void scheduleFlush(Connection *conn)
+{
+    pthread_mutex_lock(&flush_mutex);
+    int wake = (flush_list == NULL && !pthread_equal(pthread_self(), loop_thread));
+    if (!conn->flush_queued)
+    {
+        conn->flush_queued = 1;
+        conn->next_flush = flush_list;
+        flush_list = conn;
+    }
+    pthread_mutex_unlock(&flush_mutex);
 
-Car connected_cars[10];
-pthread_mutex_t cars_mutex = PTHREAD_MUTEX_INITIALIZER;
+    if (wake)
+    {
+        uint64_t one = 1;
+        write(loop_wakefd, &one, sizeof(one));
+    }
+}
 
-// Forward declarations
-void receiveMessage(int sockfd, char *buffer, int buffer_size);
-void handleCarRegistration(const char *car_name, const char *lowest_floor, const char *highest_floor, int sockfd);
-void handleCallRequest(const char *source_floor, const char *destination_floor, int client_fd);
+// handOverToLoop: give a connection to the event loop, which adds it to its epoll set on its
+// next pass. The caller must not touch the connection afterwards.
+void handOverToLoop(Connection *conn)
+{
+    pthread_mutex_lock(&conn->out_mutex);
+    conn->on_loop = 1;
+    pthread_mutex_unlock(&conn->out_mutex);
+    scheduleFlush(conn);
+}
 
-int floor_to_int(const char *floor_str)
+// queueFrame: append a framed payload to a connection's outbound queue without touching the socket,
+// optionally marking it as the last thing the connection will send.
+// Safe to call while holding registry and car locks; the connection's owner does the actual send().
+void queueFrame(Connection *conn, const void *payload, uint16_t len, int last)
 {
-    if (floor_str[0] == 'B')
+    OutFrame *frame = malloc(sizeof(OutFrame) + sizeof(uint16_t) + len);
+    uint16_t net_len = htons(len);
+    memcpy(frame->data, &net_len, sizeof(net_len));
+    memcpy(frame->data + sizeof(net_len), payload, len);
+    frame->len = sizeof(net_len) + len;
+    frame->sent = 0;
+    frame->next = NULL;
+
+    pthread_mutex_lock(&conn->out_mutex);
+    if (conn->out_bytes + frame->len > OUTQ_MAX_BYTES)
     {
-        return -atoi(&floor_str[1]);
+        // Peer has stopped reading; give up on it rather than buffer forever
+        conn->out_broken = 1;
+        free(frame);
     }
     else
     {
-        return atoi(floor_str);
+        if (conn->out_tail != NULL)
+            conn->out_tail->next = frame;
+        else
+            conn->out_head = frame;
+        conn->out_tail = frame;
+        conn->out_bytes += frame->len;
     }
-}
+    if (last)
+        conn->close_after_send = 1;
+    int wakefd = conn->wakefd;
+    int on_loop = conn->on_loop;
+    pthread_mutex_unlock(&conn->out_mutex);
 
-void int_to_floor(int floor_num, char *floor_str)
-{
-    if (floor_num < 0)
+    if (wakefd != -1)
     {
-        sprintf(floor_str, "B%d", -floor_num);
+        uint64_t one = 1;
+        write(wakefd, &one, sizeof(one));
     }
-    else
+    else if (on_loop)
     {
-        sprintf(floor_str, "%d", floor_num);
+        scheduleFlush(conn);
     }
 }
 
-int is_floor_in_queue(Node *queue, int floor)
+// queueBytes: queue a framed payload for the connection's owner to send
+void queueBytes(Connection *conn, const void *payload, uint16_t len)
+{
+    queueFrame(conn, payload, len, 0);
+}
+
+// queueMessage: queueBytes() for a text message
+void queueMessage(Connection *conn, const char *msg)
 {
-    Node *current = queue;
-    while (current != NULL)
+    queueBytes(conn, msg, strlen(msg));
+}
+
+// flushQueue: write as much queued output as the socket takes without blocking.
+// Returns -1 if the connection is broken and should be closed.
+int flushQueue(Connection *conn)
+{
+    pthread_mutex_lock(&conn->out_mutex);
+    OutFrame *frame = conn->out_head;
+    int broken = conn->out_broken;
+    conn->out_head = conn->out_tail = NULL;
+    pthread_mutex_unlock(&conn->out_mutex);
+
+    if (broken)
     {
-        if (current->floor == floor)
+        fprintf(stderr, "Socket %d is not reading its messages, dropping it\n", conn->sockfd);
+    }
+
+    // Everything queued goes out in one gather write, FRAME_BATCH_MAX frames at a time
+    size_t sent_bytes = 0;
+    while (frame != NULL && !broken)
+    {
+        struct iovec iov[FRAME_BATCH_MAX];
+        int count = 0;
+        size_t batch_bytes = 0;
+        for (OutFrame *f = frame; f != NULL && count < FRAME_BATCH_MAX; f = f->next)
+        {
+            iov[count].iov_base = f->data + f->sent;
+            iov[count].iov_len = f->len - f->sent;
+            batch_bytes += iov[count].iov_len;
+            count++;
+        }
+
+        ssize_t n = frameSendBatch(conn->sockfd, iov, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                broken = 1;
+            break;
+        }
+        sent_bytes += n;
+
+        // Free the frames that went out completely
+        size_t left = n;
+        while (frame != NULL && left >= frame->len - frame->sent)
         {
-            return 1; // Already in queue
+            left -= frame->len - frame->sent;
+            OutFrame *next = frame->next;
+            free(frame);
+            frame = next;
         }
-        current = current->next;
+        if (frame != NULL)
+            frame->sent += left;
+
+        if ((size_t)n < batch_bytes)
+            break; // Socket buffer is full
+    }
+
+    // Put back whatever the socket would not take, ahead of anything queued meanwhile
+    pthread_mutex_lock(&conn->out_mutex);
+    conn->out_bytes -= sent_bytes;
+    if (frame != NULL)
+    {
+        OutFrame *last = frame;
+        while (last->next != NULL)
+            last = last->next;
+        last->next = conn->out_head;
+        if (conn->out_head == NULL)
+            conn->out_tail = last;
+        conn->out_head = frame;
     }
-    return 0; // Not in queue
+    if (broken)
+        conn->out_broken = 1;
+    pthread_mutex_unlock(&conn->out_mutex);
+
+    return broken ? -1 : 0;
 }
 
-// Insert pickup floor below current peak (in ascending section)
-void insert_below_peak(Node **queue, int peak_floor, int floor)
+// hasQueuedOutput: 1 if the connection still has bytes waiting to be sent
+int hasQueuedOutput(Connection *conn)
 {
-    Node *new_node = malloc(sizeof(Node));
-    new_node->floor = floor;
-    new_node->next = NULL;
+    pthread_mutex_lock(&conn->out_mutex);
+    int pending = (conn->out_head != NULL);
+    pthread_mutex_unlock(&conn->out_mutex);
+    return pending;
+}
 
-    if (*queue == NULL)
+// finishedSending: 1 once a connection that should close after its reply has sent it
+int finishedSending(Connection *conn)
+{
+    pthread_mutex_lock(&conn->out_mutex);
+    int done = conn->close_after_send && conn->out_head == NULL;
+    pthread_mutex_unlock(&conn->out_mutex);
+    return done;
+}
+
+// sendFloorToCar: dispatch's way of talking to a car, queued for the connection's owner to send
+void sendFloorToCar(Car *car, int floor)
+{
+    Connection *conn = car->conn;
+    if (conn == NULL)
     {
-        *queue = new_node;
         return;
     }
 
-    // Insert in ascending order until we hit the peak
-    Node *curr = *queue;
-    Node *prev = NULL;
-
-    while (curr != NULL && curr->floor < peak_floor)
+    if (conn->protocol == PROTOCOL_BINARY)
     {
-        if (floor < curr->floor)
-        {
-            // Insert here
-            new_node->next = curr;
-            if (prev == NULL)
-            {
-                *queue = new_node;
-            }
-            else
-            {
-                prev->next = new_node;
-            }
-            return;
-        }
-        prev = curr;
-        curr = curr->next;
+        uint8_t payload[V2_MESSAGE_SIZE];
+        V2Message msg = {V2_FLOOR, 0, conn->out_seq++, floor, 0};
+        queueBytes(conn, payload, encodeV2(payload, &msg));
     }
+    else
+    {
+        char floor_str[4];
+        char floor_msg[16];
+        int_to_floor(floor, floor_str);
+        sprintf(floor_msg, "FLOOR %s", floor_str);
+        queueMessage(conn, floor_msg);
+    }
+}
 
-    // Insert before peak
-    new_node->next = curr;
-    if (prev == NULL)
+// sendCallReply: batch mode's answer to a call, queued for the connection's owner to send.
+// A one-shot call's connection is closed once its reply is out.
+void sendCallReply(Connection *conn, const char *id, const char *car_name)
+{
+    char reply[BUFFER_SIZE];
+    if (id == NULL)
+    {
+        if (car_name != NULL)
+            snprintf(reply, sizeof(reply), "CAR %s", car_name);
+        else
+            snprintf(reply, sizeof(reply), "UNAVAILABLE");
+    }
+    else if (car_name != NULL)
     {
-        *queue = new_node;
+        snprintf(reply, sizeof(reply), "CAR %s %s", id, car_name);
     }
     else
     {
-        prev->next = new_node;
+        snprintf(reply, sizeof(reply), "UNAVAILABLE %s", id);
     }
+    queueFrame(conn, reply, strlen(reply), id == NULL);
 }
 
-// Insert pickup floor above current peak (becomes new peak)
-void insert_above_peak(Node **queue, int *peak_floor, int floor)
+void handleCallRequest(const char *source_floor, const char *destination_floor, int client_fd)
 {
-    Node *new_node = malloc(sizeof(Node));
-    new_node->floor = floor;
-    new_node->next = NULL;
+    long started = latency_clock();
+    logInfo("Handling call request from %s to %s\n", source_floor, destination_floor);
 
-    if (*queue == NULL)
+    char car_name[50];
+    if (assignCall(floor_to_int(source_floor), floor_to_int(destination_floor), car_name) == 0)
     {
-        *queue = new_node;
-        *peak_floor = floor;
+        latencyRecordByName(car_name, LATENCY_ASSIGN, latency_clock() - started);
+        // Acknowledge to the call pad; no registry or car lock is held here
+        char ack[BUFFER_SIZE];
+        sprintf(ack, "CAR %s", car_name);
+        frameSend(client_fd, ack, MSG_NOSIGNAL);
+        latencyRecordByName(car_name, LATENCY_HANDLE, latency_clock() - started);
         return;
     }
 
-    // Find the END of the ascending section (right before it starts descending)
-    Node *curr = *queue;
-
-    while (curr->next != NULL && curr->next->floor > curr->floor)
+    char trip[TRIP_REPLY_SIZE];
+    if (transfers_enabled && assignTrip(floor_to_int(source_floor), floor_to_int(destination_floor), started,
+                                        trip, sizeof(trip)) > 0)
     {
-        // Still ascending
-        curr = curr->next;
+        latencyRecordByName(trip, LATENCY_ASSIGN, latency_clock() - started);
+        char ack[BUFFER_SIZE];
+        snprintf(ack, sizeof(ack), "CAR %s", trip);
+        frameSend(client_fd, ack, MSG_NOSIGNAL);
+        latencyRecordByName(trip, LATENCY_HANDLE, latency_clock() - started);
+        return;
     }
 
-    // Now curr is the last ascending node (the current peak)
-    // Insert new peak after it
-    new_node->next = curr->next;
-    curr->next = new_node;
-
-    *peak_floor = floor; // Update peak to new value
+    // No car could handle the request
+    logWarn("No active cars to handle the call request.\n");
+    frameSend(client_fd, "UNAVAILABLE", MSG_NOSIGNAL);
+    latencyRecordByName(NULL, LATENCY_HANDLE, latency_clock() - started);
 }
 
-// Insert dropoff in descending section (after peak)
-void append_to_descent(Node **queue, int peak_floor, int floor)
+// handleSessionCall: answer one "CALL <id> <src> <dst>" on a session with "CAR <id> <name>"
+// (or a trip, as for one-shot calls) or "UNAVAILABLE <id>". Replies are queued, so the pad may pipeline as many calls as it likes.
+void handleSessionCall(Connection *conn, const char *buffer)
 {
-    Node *new_node = malloc(sizeof(Node));
-    new_node->floor = floor;
-    new_node->next = NULL;
+    char id[16], source[4], dest[4];
+    if (sscanf(buffer, "%*s %15s %3s %3s", id, source, dest) != 3)
+    {
+        queueMessage(conn, "ERROR Malformed CALL");
+        return;
+    }
+    long started = latency_clock();
+    logInfo("Handling call %s from %s to %s\n", id, source, dest);
 
-    if (*queue == NULL)
+    if (batch_window_ms > 0)
     {
-        *queue = new_node;
+        // Assigned, and its assign time recorded, when the window closes
+        batchAddCall(floor_to_int(source), floor_to_int(dest), conn, id);
+        latencyRecordByName(NULL, LATENCY_HANDLE, latency_clock() - started);
         return;
     }
 
-    // Find the peak, then insert in descending order after it
-    Node *curr = *queue;
+    char reply[BUFFER_SIZE];
+    char car_name[50];
+    char trip[TRIP_REPLY_SIZE];
+    const char *cars = NULL;
+    if (assignCall(floor_to_int(source), floor_to_int(dest), car_name) == 0)
+    {
+        cars = car_name;
+    }
+    else if (transfers_enabled && assignTrip(floor_to_int(source), floor_to_int(dest), started, trip, sizeof(trip)) > 0)
+    {
+        cars = trip;
+    }
 
-    // Skip to the peak node itself
-    while (curr != NULL && curr->floor != peak_floor)
+    if (cars != NULL)
     {
-        if (curr->next == NULL)
-            break;
-        curr = curr->next;
+        latencyRecordByName(cars, LATENCY_ASSIGN, latency_clock() - started);
+        snprintf(reply, sizeof(reply), "CAR %s %s", id, cars);
     }
+    else
+    {
+        logWarn("No active cars to handle the call request.\n");
+        snprintf(reply, sizeof(reply), "UNAVAILABLE %s", id);
+    }
+    queueMessage(conn, reply);
+    latencyRecordByName(cars, LATENCY_HANDLE, latency_clock() - started);
+}
 
-    if (curr == NULL || curr->floor != peak_floor)
+// handleStatusUpdate: parse a STATUS message from a car
+void handleStatusUpdate(const char *buffer, int sockfd)
+{
+    char status[8], current[4], dest[4];
+    if (sscanf(buffer, "%*s %7s %3s %3s", status, current, dest) != 3)
     {
-        // Couldn't find peak, just append at end
-        curr = *queue;
-        while (curr->next != NULL)
-        {
-            curr = curr->next;
-        }
-        curr->next = new_node;
         return;
     }
+    updateCarStatus(sockfd, carStatusFromName(status), floor_to_int(current), floor_to_int(dest));
+}
+
+// handleBinaryMessage: one version 2 message from a car that negotiated it.
+// Returns -1 if it is malformed, which ends the connection like a garbled text stream would.
+int handleBinaryMessage(Connection *conn, const FrameView *frame)
+{
+    V2Message msg;
+    if (decodeV2((const uint8_t *)frame->data, frame->len, &msg) != 0)
+    {
+        fprintf(stderr, "Car %s sent a malformed binary message\n", conn->car_name);
+        return -1;
+    }
 
-    // Now insert in descending order after the peak
-    while (curr->next != NULL && curr->next->floor > floor)
+    if (msg.seq != conn->in_seq)
     {
-        curr = curr->next;
+        logWarn("Car %s: expected message %u, got %u\n", conn->car_name, conn->in_seq, msg.seq);
     }
+    conn->in_seq = msg.seq + 1;
 
-    new_node->next = curr->next;
-    curr->next = new_node;
+    if (msg.type == V2_INDIVIDUAL_SERVICE || msg.type == V2_EMERGENCY)
+    {
+        handleCarDisconnect(conn->car_name, conn->sockfd,
+                            msg.type == V2_EMERGENCY ? "entered emergency mode" : "entered individual service");
+    }
+    else if (msg.type == V2_STATUS)
+    {
+        char current[8], dest[8];
+        int_to_floor(msg.floor, current);
+        int_to_floor(msg.destination, dest);
+        logDebug("Received STATUS %s %s %s from car %s\n", carStatusName(msg.status), current, dest,
+                 conn->car_name);
+        updateCarStatus(conn->sockfd, msg.status, msg.floor, msg.destination);
+    }
+    return 0;
 }
 
-void receiveMessage(int sockfd, char *buffer, int buffer_size)
+// handleStatsRequest: reply with the controller's runtime statistics: the worker pool, calls
+// moved off cars that left service and hall calls coalesced
+void handleStatsRequest(int sockfd)
 {
-    uint16_t len;
-    if (recv(sockfd, &len, sizeof(len), 0) != sizeof(len))
+    char reply[BUFFER_SIZE];
+
+    if (pool.num_workers == 0)
     {
-        buffer[0] = '\0';
-        return;
+        snprintf(reply, sizeof(reply), "POOL disabled");
     }
-    len = ntohs(len);
-
-    if (len >= buffer_size)
+    else
     {
-        fprintf(stderr, "Received message is too large for buffer\n");
-        buffer[0] = '\0';
-        return;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        pthread_mutex_lock(&pool.mutex);
+        double elapsed = timespecDiff(&pool.started, &now);
+        double utilisation = elapsed > 0 ? pool.busy_seconds / (elapsed * pool.num_workers) : 0;
+        snprintf(reply, sizeof(reply),
+                 "POOL workers=%d busy=%d queued=%d peak_queued=%d capacity=%d "
+                 "submitted=%lu completed=%lu full_waits=%lu utilisation=%.3f",
+                 pool.num_workers, pool.busy, pool.count, pool.peak_queued, POOL_QUEUE_CAPACITY,
+                 pool.submitted, pool.completed, pool.full_waits, utilisation);
+        pthread_mutex_unlock(&pool.mutex);
     }
 
-    recv(sockfd, buffer, len, 0);
-    buffer[len] = '\0';
+    size_t len = strlen(reply);
+    reply[len++] = ' ';
+    reassignDescribe(reply + len, sizeof(reply) - len);
+    len += strlen(reply + len);
+    reply[len++] = ' ';
+    coalesceDescribe(reply + len, sizeof(reply) - len);
+    frameSend(sockfd, reply, MSG_NOSIGNAL);
 }
 
-void handleCarRegistration(const char *car_name, const char *lowest_floor, const char *highest_floor, int sockfd)
+// handleMessage: process one complete message on a connection.
+// The first message decides what the connection is (car, one-shot call or call pad session).
+// Returns 0 to keep the connection open, -1 when it should be closed.
+int handleMessage(Connection *conn, const char *buffer)
 {
-    pthread_mutex_lock(&cars_mutex);
+    logDebug("Received message: [%s]\n", buffer);
 
-    // Check if car already exists (reconnecting)
-    for (int i = 0; i < 10; i++)
+    if (conn->kind == CONN_CAR)
     {
-        if (connected_cars[i].is_active && strcmp(connected_cars[i].name, car_name) == 0)
+        if (strncmp(buffer, "STATUS", 6) == 0)
+        {
+            handleStatusUpdate(buffer, conn->sockfd);
+        }
+        else if (strcmp(buffer, "INDIVIDUAL SERVICE") == 0)
+        {
+            // Out of dispatch now, rather than when the car gets round to disconnecting
+            handleCarDisconnect(conn->car_name, conn->sockfd, "entered individual service");
+        }
+        else if (strcmp(buffer, "EMERGENCY") == 0)
         {
-            connected_cars[i].sockfd = sockfd;
-            pthread_mutex_unlock(&cars_mutex);
-            return;
+            handleCarDisconnect(conn->car_name, conn->sockfd, "entered emergency mode");
         }
+        return 0;
     }
 
-    // Register new car
-    for (int i = 0; i < 10; i++)
+    if (conn->kind == CONN_CALL)
     {
-        if (!connected_cars[i].is_active)
+        return 0; // Batch mode, still waiting for its reply
+    }
+
+    if (conn->kind == CONN_SESSION)
+    {
+        if (strncmp(buffer, "CALL", 4) == 0)
+        {
+            handleSessionCall(conn, buffer);
+        }
+        else
         {
-            strcpy(connected_cars[i].name, car_name);
-            connected_cars[i].is_active = 1;
-            connected_cars[i].sockfd = sockfd;
-            strcpy(connected_cars[i].current_floor, lowest_floor);
-            strcpy(connected_cars[i].destination_floor, lowest_floor);
-            strcpy(connected_cars[i].status, "Closed");
-            connected_cars[i].lowest_floor = floor_to_int(lowest_floor);
-            connected_cars[i].highest_floor = floor_to_int(highest_floor);
-            connected_cars[i].queue = NULL;
-            connected_cars[i].peak_floor = floor_to_int(lowest_floor); // Initialize peak
-            printf("Registered new car: %s (Floors: %s to %s)\n", car_name, lowest_floor, highest_floor);
-            pthread_mutex_unlock(&cars_mutex);
-            return;
+            queueMessage(conn, "ERROR Unknown command");
         }
+        return 0;
     }
 
-    printf("No space to register new car: %s\n", car_name);
-    pthread_mutex_unlock(&cars_mutex);
+    if (strncmp(buffer, "CAR", 3) == 0)
+    {
+        // "CAR <name> <lowest> <highest> [BINARY]"; anything else is refused before the car is seen
+        char lowest[8], highest[8], offer[16];
+        int fields = sscanf(buffer, "%*s %49s %7s %7s %15s", conn->car_name, lowest, highest, offer);
+        if (fields < 3 || !is_floor_valid(lowest) || !is_floor_valid(highest) ||
+            floor_to_int(lowest) > floor_to_int(highest) || (fields == 4 && strcmp(offer, PROTOCOL_OFFER) != 0))
+        {
+            logWarn("Refused malformed car registration [%s]\n", buffer);
+            frameSend(conn->sockfd, "ERROR Malformed CAR registration", MSG_NOSIGNAL);
+            return -1;
+        }
+
+        // Switch to binary before the car is visible to dispatch, so every FLOOR it gets is binary
+        if (fields == 4)
+        {
+            queueMessage(conn, PROTOCOL_ACCEPT);
+            conn->protocol = PROTOCOL_BINARY;
+        }
+        handleCarRegistration(conn->car_name, lowest, highest, conn->sockfd, conn);
+
+        // Keep the kernel buffer small so a car that stops reading shows up in its
+        // outbound queue (and gets dropped) instead of hiding in an autotuned buffer
+        int sndbuf = CAR_SNDBUF;
+        setsockopt(conn->sockfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        logInfo("Car %s connected on socket %d\n", conn->car_name, conn->sockfd);
+        conn->kind = CONN_CAR;
+        return 0;
+    }
+    else if (strncmp(buffer, "CALL", 4) == 0)
+    {
+        char source[4], dest[4];
+        sscanf(buffer, "%*s %3s %3s", source, dest);
+        conn->kind = CONN_CALL;
+        if (batch_window_ms > 0)
+        {
+            // Answered when the window closes, then the connection is closed
+            logInfo("Holding call request from %s to %s for the batch\n", source, dest);
+            batchAddCall(floor_to_int(source), floor_to_int(dest), conn, NULL);
+            return 0;
+        }
+        handleCallRequest(source, dest, conn->sockfd);
+    }
+    else if (strcmp(buffer, "SESSION") == 0)
+    {
+        conn->kind = CONN_SESSION;
+        queueMessage(conn, "SESSION OK");
+        return 0;
+    }
+    else if (strcmp(buffer, "STATS") == 0)
+    {
+        handleStatsRequest(conn->sockfd);
+    }
+    else if (strcmp(buffer, "ZONES") == 0)
+    {
+        char reply[BUFFER_SIZE];
+        zoningDescribe(reply, sizeof(reply));
+        frameSend(conn->sockfd, reply, MSG_NOSIGNAL);
+    }
+    else if (strcmp(buffer, "TRAFFIC") == 0)
+    {
+        char reply[BUFFER_SIZE];
+        trafficDescribe(reply, sizeof(reply));
+        frameSend(conn->sockfd, reply, MSG_NOSIGNAL);
+    }
+    else if (strcmp(buffer, "LATENCY") == 0 || strncmp(buffer, "LATENCY ", 8) == 0)
+    {
+        // "LATENCY" for the fleet, "LATENCY <car>" for one car
+        char reply[BUFFER_SIZE];
+        latencyDescribe(buffer[7] == ' ' ? &buffer[8] : NULL, reply, sizeof(reply));
+        frameSend(conn->sockfd, reply, MSG_NOSIGNAL);
+    }
+    else
+    {
+        frameSend(conn->sockfd, "ERROR Unknown command", MSG_NOSIGNAL);
+    }
+    return -1;
 }
 
-void handleCallRequest(const char *source_floor, const char *destination_floor, int client_fd)
+// closeConnection: release a connection, unregistering its car if it was one
+void closeConnection(Connection *conn)
+{
+    if (conn->kind == CONN_CAR)
+    {
+        handleCarDisconnect(conn->car_name, conn->sockfd, "disconnected");
+    }
+    else if (batch_window_ms > 0 && (conn->kind == CONN_CALL || conn->kind == CONN_SESSION))
+    {
+        batchCancel(conn);
+    }
+    close(conn->sockfd);
+}
+
+// handleFrames: handle every complete frame already buffered on a connection.
+// Returns -1 if the connection should be closed.
+int handleFrames(Connection *conn)
 {
-    printf("Handling call request from %s to %s\n", source_floor, destination_floor);
+    FrameView frame;
+    int got;
+    while ((got = frameNext(&conn->in, &frame)) == 1)
+    {
+        int result = conn->protocol == PROTOCOL_BINARY ? handleBinaryMessage(conn, &frame)
+                                                       : handleMessage(conn, frame.data);
+        if (result != 0)
+        {
+            return -1;
+        }
+    }
+    if (got < 0)
+    {
+        fprintf(stderr, "Received message is too large for buffer\n");
+        return -1;
+    }
+    return 0;
+}
 
-    int source = floor_to_int(source_floor);
-    int dest = floor_to_int(destination_floor);
+// readFrames: read what the socket has for a connection and handle every complete frame.
+// Returns -1 if the peer has gone away or the connection should otherwise be closed.
+int readFrames(Connection *conn)
+{
+    int result = frameRead(&conn->in, conn->sockfd, MSG_DONTWAIT);
+    if (result == FRAME_AGAIN)
+    {
+        return 0;
+    }
+    if (result != FRAME_OK)
+    {
+        return -1;
+    }
+    return handleFrames(conn);
+}
 
-    pthread_mutex_lock(&cars_mutex);
+// handleConnection: connection thread for --threads mode (every socket) and --pool mode (cars).
+// Waits on the socket and the connection's eventfd so queued FLOOR messages are sent by
+// this thread alone, never by whoever made the dispatch decision.
+void *handleConnection(void *arg)
+{
+    Connection *conn = (Connection *)arg;
 
-    for (int i = 0; i < 10; i++)
+    while (flushQueue(conn) == 0 && !finishedSending(conn))
     {
-        if (!connected_cars[i].is_active)
-            continue;
+        struct pollfd fds[2];
+        fds[0].fd = conn->sockfd;
+        fds[0].events = POLLIN | (hasQueuedOutput(conn) ? POLLOUT : 0);
+        fds[1].fd = conn->wakefd;
+        fds[1].events = POLLIN;
 
-        // Check if car can reach both floors
-        if (source < connected_cars[i].lowest_floor ||
-            source > connected_cars[i].highest_floor ||
-            dest < connected_cars[i].lowest_floor ||
-            dest > connected_cars[i].highest_floor)
+        if (poll(fds, 2, -1) == -1)
         {
-            continue;
+            if (errno == EINTR)
+                continue;
+            break;
         }
 
-        // Determine effective floor (where car actually is or is going)
-        int effective_floor;
-        if (strcmp(connected_cars[i].status, "Closing") == 0 ||
-            strcmp(connected_cars[i].status, "Between") == 0)
+        if (fds[1].revents & POLLIN)
         {
-            effective_floor = floor_to_int(connected_cars[i].destination_floor);
-        }
-        else
-        {
-            effective_floor = floor_to_int(connected_cars[i].current_floor);
+            uint64_t count;
+            read(conn->wakefd, &count, sizeof(count));
         }
 
-        // If queue is empty, initialize peak to effective floor
-        if (connected_cars[i].queue == NULL)
+        if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && readFrames(conn) != 0)
         {
-            connected_cars[i].peak_floor = effective_floor;
+            break;
         }
+    }
 
-        // Determine car's direction based on actual movement
-        int car_current = floor_to_int(connected_cars[i].current_floor);
-        int car_dest = floor_to_int(connected_cars[i].destination_floor);
-        int is_going_up = (car_dest > car_current);
-        int is_going_down = (car_dest < car_current);
+    closeConnection(conn);
+    freeConnection(conn);
+    return NULL;
+}
 
-        // Determine if source is ahead or behind the car
-        int source_ahead = 0;
+// updateEpollInterest: ask for EPOLLOUT only while a connection has output the socket would not take
+void updateEpollInterest(int epfd, Connection *conn)
+{
+    int want_write = hasQueuedOutput(conn);
+    if (want_write != conn->want_write)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+        ev.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, conn->sockfd, &ev);
+        conn->want_write = want_write;
+    }
+}
+
+// closeEventConnection: remove a connection from the event loop and free it.
+// Unregistering it first means no other thread (the batch timer, dispatch) can queue to it
+// and put it back on the flush list once it has been taken off.
+void closeEventConnection(int epfd, Connection *conn)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+    closeConnection(conn);
+
+    pthread_mutex_lock(&flush_mutex);
+    if (conn->flush_queued)
+    {
+        Connection **link = &flush_list;
+        while (*link != conn)
+            link = &(*link)->next_flush;
+        *link = conn->next_flush;
+        conn->flush_queued = 0;
+    }
+    pthread_mutex_unlock(&flush_mutex);
+
+    freeConnection(conn);
+}
+
+// eventLoopSetup: create the event loop's epoll set and the eventfd other threads wake it with.
+// Returns the epoll fd, or -1.
+int eventLoopSetup(void)
+{
+    int epfd = epoll_create1(0);
+    if (epfd == -1)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    loop_wakefd = eventfd(0, EFD_NONBLOCK);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = LOOP_WAKE_MARKER;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, loop_wakefd, &ev);
+    return epfd;
+}
 
-        if (is_going_up)
+// eventLoopRun: run the event loop on an epoll set from eventLoopSetup(), accepting clients
+// on the listening sockets if accept_clients is set
+int eventLoopRun(int epfd, int accept_clients)
+{
+    struct epoll_event ev;
+    for (int l = 0; accept_clients && l < num_listen_fds; l++)
+    {
+        fcntl(listen_fds[l], F_SETFL, fcntl(listen_fds[l], F_GETFL, 0) | O_NONBLOCK);
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL; // NULL marks a listening socket
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fds[l], &ev) == -1)
         {
-            source_ahead = (source >= effective_floor);
+            perror("epoll_ctl");
+            return 1;
         }
-        else if (is_going_down)
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1)
+    {
+        int count = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (count == -1)
         {
-            source_ahead = (source <= effective_floor);
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            return 1;
         }
-        else
+
+        for (int i = 0; i < count; i++)
         {
-            // Idle - any source is "ahead"
-            source_ahead = 1;
-        }
+            Connection *conn = events[i].data.ptr;
 
-        // Determine if we're at/past the peak
-        int at_or_past_peak = (car_current >= connected_cars[i].peak_floor);
+            if (conn == LOOP_WAKE_MARKER)
+            {
+                // Output queued by another thread; it is flushed below
+                uint64_t count;
+                read(loop_wakefd, &count, sizeof(count));
+                continue;
+            }
 
-        // Insert source floor
-        if (!is_floor_in_queue(connected_cars[i].queue, source))
-        {
-            if (source > connected_cars[i].peak_floor)
+            if (conn == NULL)
+            {
+                // Accept everything that is waiting, on whichever listener it is
+                for (int l = 0; l < num_listen_fds; l++)
+                {
+                    while (1)
+                    {
+                        int clientfd = accept(listen_fds[l], NULL, NULL);
+                        if (clientfd == -1)
+                        {
+                            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                                perror("accept");
+                            break;
+                        }
+
+                        logInfo("Accepted a new connection.\n");
+
+                        Connection *new_conn = newConnection(clientfd);
+                        new_conn->on_loop = 1;
+                        new_conn->watched = 1;
+
+                        ev.events = EPOLLIN | EPOLLRDHUP;
+                        ev.data.ptr = new_conn;
+                        if (epoll_ctl(epfd, EPOLL_CTL_ADD, clientfd, &ev) == -1)
+                        {
+                            perror("epoll_ctl");
+                            close(clientfd);
+                            freeConnection(new_conn);
+                        }
+                    }
+                }
+                continue;
+            }
+
+            int should_close = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+            if (!should_close && (events[i].events & EPOLLOUT))
+            {
+                should_close = (flushQueue(conn) != 0);
+            }
+            if (!should_close && (events[i].events & (EPOLLIN | EPOLLRDHUP)))
             {
-                // Source is new peak
-                insert_above_peak(&connected_cars[i].queue, &connected_cars[i].peak_floor, source);
+                should_close = (readFrames(conn) != 0);
             }
-            else if (source_ahead && source <= connected_cars[i].peak_floor && !at_or_past_peak)
+            if (!should_close)
             {
-                // Source is ahead and below/at peak - insert in ascent
-                insert_below_peak(&connected_cars[i].queue, connected_cars[i].peak_floor, source);
+                should_close = finishedSending(conn);
             }
-            else
+
+            if (should_close)
             {
-                // Source is behind OR we're past the peak - insert in descent
-                append_to_descent(&connected_cars[i].queue, connected_cars[i].peak_floor, source);
+                closeEventConnection(epfd, conn);
+            }
+            else if (conn->want_write)
+            {
+                updateEpollInterest(epfd, conn);
             }
         }
 
-        // Insert destination floor (always goes in descent/after the journey)
-        if (!is_floor_in_queue(connected_cars[i].queue, dest))
+        // Send everything dispatch queued during this pass
+        pthread_mutex_lock(&flush_mutex);
+        Connection *pending = flush_list;
+        flush_list = NULL;
+        pthread_mutex_unlock(&flush_mutex);
+
+        while (pending != NULL)
         {
-            append_to_descent(&connected_cars[i].queue, connected_cars[i].peak_floor, dest);
+            // Each stays marked until it is taken, so queueing it again can't relink the rest
+            pthread_mutex_lock(&flush_mutex);
+            Connection *conn = pending;
+            pending = conn->next_flush;
+            conn->flush_queued = 0;
+            pthread_mutex_unlock(&flush_mutex);
+
+            if (flushQueue(conn) != 0 || finishedSending(conn))
+            {
+                closeEventConnection(epfd, conn);
+                continue;
+            }
+            if (!conn->watched)
+            {
+                // Handed over by another thread
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.ptr = conn;
+                epoll_ctl(epfd, EPOLL_CTL_ADD, conn->sockfd, &ev);
+                conn->watched = 1;
+            }
+            updateEpollInterest(epfd, conn);
         }
+    }
+
+    close(epfd);
+    return 0;
+}
+
+// runEventLoop: default mode, a single epoll loop owns the listening sockets and every client socket
+int runEventLoop(void)
+{
+    int epfd = eventLoopSetup();
+    if (epfd == -1)
+    {
+        return 1;
+    }
+    loop_thread = pthread_self();
+    return eventLoopRun(epfd, 1);
+}
+
+// replyLoop: --pool mode with --batch, an event loop that owns one-shot calls held for the batch
+// until their reply is out, so each doesn't need a thread of its own
+void *replyLoop(void *arg)
+{
+    eventLoopRun((int)(intptr_t)arg, 0);
+    return NULL;
+}
 
-        // Recalculate peak based on entire queue
-        int new_peak = connected_cars[i].queue->floor;
-        Node *curr = connected_cars[i].queue;
-        while (curr != NULL)
+// acceptClient: block until a client connects on any listening socket and accept it
+int acceptClient(void)
+{
+    struct pollfd fds[MAX_LISTENERS];
+    for (int l = 0; l < num_listen_fds; l++)
+    {
+        fds[l].fd = listen_fds[l];
+        fds[l].events = POLLIN;
+    }
+
+    while (1)
+    {
+        if (poll(fds, num_listen_fds, -1) == -1)
         {
-            if (curr->floor > new_peak)
+            if (errno != EINTR)
+                perror("poll");
+            continue;
+        }
+        for (int l = 0; l < num_listen_fds; l++)
+        {
+            if (fds[l].revents & POLLIN)
             {
-                new_peak = curr->floor;
+                int clientfd = accept(listen_fds[l], NULL, NULL);
+                if (clientfd != -1)
+                    return clientfd;
+                perror("accept");
             }
-            curr = curr->next;
         }
-        connected_cars[i].peak_floor = new_peak;
+    }
+}
 
-        // Check if we need to send a new FLOOR message
-        if (connected_cars[i].queue != NULL)
-        {
-            int first_floor_in_queue = connected_cars[i].queue->floor;
-            int current_destination = floor_to_int(connected_cars[i].destination_floor);
+// poolWorker: take accepted sockets off the pool queue and handle their first message
+void *poolWorker(void *arg)
+{
+    (void)arg;
 
-            // Send FLOOR message if:
-            // 1. Destination changed, OR
-            // 2. Car is already at this floor but doors are closed (need to reopen)
-            if (first_floor_in_queue != current_destination ||
-                (first_floor_in_queue == current_destination &&
-                 strcmp(connected_cars[i].status, "Closed") == 0))
-            {
-                char floor_str[4];
-                int_to_floor(first_floor_in_queue, floor_str);
+    while (1)
+    {
+        pthread_mutex_lock(&pool.mutex);
+        while (pool.count == 0)
+        {
+            pthread_cond_wait(&pool.not_empty, &pool.mutex);
+        }
+        int clientfd = pool.jobs[pool.head];
+        pool.head = (pool.head + 1) % POOL_QUEUE_CAPACITY;
+        pool.count--;
+        pool.busy++;
+        pthread_cond_signal(&pool.not_full);
+        pthread_mutex_unlock(&pool.mutex);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        Connection *conn = newConnection(clientfd);
+
+        // Don't let a silent client hold a worker forever
+        struct timeval timeout = {POOL_RECV_TIMEOUT, 0};
+        setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        // Wait for the first whole message; a timeout or disconnect leaves got at 0
+        FrameView frame;
+        int got;
+        while ((got = frameNext(&conn->in, &frame)) == 0 &&
+               frameRead(&conn->in, clientfd, 0) == FRAME_OK)
+        {
+        }
+        int keep_open = (got == 1 && handleMessage(conn, frame.data) == 0);
 
-                char floor_msg[BUFFER_SIZE];
-                sprintf(floor_msg, "FLOOR %s", floor_str);
-                uint16_t len = strlen(floor_msg);
-                uint16_t net_len = htons(len);
-                send(connected_cars[i].sockfd, &net_len, sizeof(net_len), 0);
-                send(connected_cars[i].sockfd, floor_msg, len, 0);
+        // A car's first STATUS, or a session's first calls, may have come in the same read
+        if (keep_open && handleFrames(conn) != 0)
+        {
+            keep_open = 0;
+        }
 
-                printf("Sent FLOOR %s to car %s\n", floor_str, connected_cars[i].name);
-            }
+        if (keep_open && conn->kind == CONN_CALL)
+        {
+            // A one-shot call held for the batch; the reply loop sends its reply and closes it
+            handOverToLoop(conn);
+        }
+        else if (keep_open)
+        {
+            // Cars and call pad sessions stay connected, give them a thread of their own
+            struct timeval no_timeout = {0, 0};
+            setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &no_timeout, sizeof(no_timeout));
+
+            // Anything queued before the eventfd exists is sent by the thread's first flush
+            int wakefd = eventfd(0, 0);
+            pthread_mutex_lock(&conn->out_mutex);
+            conn->wakefd = wakefd;
+            pthread_mutex_unlock(&conn->out_mutex);
+
+            pthread_t thread;
+            pthread_create(&thread, NULL, handleConnection, conn);
+            pthread_detach(thread);
+        }
+        else
+        {
+            closeConnection(conn);
+            freeConnection(conn);
         }
 
-        // Send acknowledgment to call pad
-        char ack[BUFFER_SIZE];
-        sprintf(ack, "CAR %s", connected_cars[i].name);
-        uint16_t len = strlen(ack);
-        uint16_t net_len = htons(len);
-        send(client_fd, &net_len, sizeof(net_len), 0);
-        send(client_fd, ack, len, 0);
+        clock_gettime(CLOCK_MONOTONIC, &end);
 
-        pthread_mutex_unlock(&cars_mutex);
-        return;
+        pthread_mutex_lock(&pool.mutex);
+        pool.busy--;
+        pool.completed++;
+        pool.busy_seconds += timespecDiff(&start, &end);
+        pthread_mutex_unlock(&pool.mutex);
     }
 
-    pthread_mutex_unlock(&cars_mutex);
-
-    // No car could handle the request
-    printf("No active cars to handle the call request.\n");
-    char error[] = "UNAVAILABLE";
-    uint16_t len = strlen(error);
-    uint16_t net_len = htons(len);
-    send(client_fd, &net_len, sizeof(net_len), 0);
-    send(client_fd, error, len, 0);
+    return NULL;
 }
 
-void *handleConnection(void *arg)
+// runWorkerPool: accept loop hands sockets to a fixed pool of workers, blocking while the queue is full
+int runWorkerPool(int num_workers)
 {
-    int sockfd = *(int *)arg;
-    free(arg);
-
-    char buffer[BUFFER_SIZE];
-    receiveMessage(sockfd, buffer, sizeof(buffer));
-    printf("Received message: [%s]\n", buffer);
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.not_empty, NULL);
+    pthread_cond_init(&pool.not_full, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &pool.started);
 
-    if (strncmp(buffer, "CAR", 3) == 0)
+    if (batch_window_ms > 0)
     {
-        char car_name[50], lowest[4], highest[4];
-        sscanf(buffer, "%*s %49s %3s %3s", car_name, lowest, highest);
-        handleCarRegistration(car_name, lowest, highest, sockfd);
-        printf("Car %s connected on socket %d\n", car_name, sockfd);
-
-        // Handle persistent car connection
-        while (1)
+        int epfd = eventLoopSetup();
+        if (epfd == -1 || pthread_create(&loop_thread, NULL, replyLoop, (void *)(intptr_t)epfd) != 0)
         {
-            receiveMessage(sockfd, buffer, sizeof(buffer));
+            fprintf(stderr, "Could not start the batch reply loop\n");
+            return 1;
+        }
+    }
 
-            // Check if car disconnected
-            if (buffer[0] == '\0')
-            {
-                printf("Car %s disconnected\n", car_name);
-                pthread_mutex_lock(&cars_mutex);
-                for (int i = 0; i < 10; i++)
-                {
-                    if (connected_cars[i].sockfd == sockfd)
-                    {
-                        connected_cars[i].is_active = 0;
-                        break;
-                    }
-                }
-                pthread_mutex_unlock(&cars_mutex);
-                break;
-            }
+    pool.threads = malloc(sizeof(pthread_t) * num_workers);
+    for (int i = 0; i < num_workers; i++)
+    {
+        if (pthread_create(&pool.threads[i], NULL, poolWorker, NULL) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    pool.num_workers = num_workers;
 
-            // Handle STATUS messages
-            if (strncmp(buffer, "STATUS", 6) == 0)
-            {
-                char status[8], current[4], dest[4];
-                sscanf(buffer, "%*s %7s %3s %3s", status, current, dest);
+    while (1)
+    {
+        int clientfd = acceptClient();
 
-                pthread_mutex_lock(&cars_mutex);
-                for (int i = 0; i < 10; i++)
-                {
-                    if (connected_cars[i].sockfd == sockfd)
-                    {
-                        strcpy(connected_cars[i].status, status);
-                        strcpy(connected_cars[i].current_floor, current);
-                        strcpy(connected_cars[i].destination_floor, dest);
+        logInfo("Accepted a new connection.\n");
 
-                        // Car arrived at a floor - pop from queue and send next
-                        if (strcmp(status, "Opening") == 0 && strcmp(current, dest) == 0)
-                        {
-                            if (connected_cars[i].queue != NULL)
-                            {
-                                // Pop the first floor
-                                Node *temp = connected_cars[i].queue;
-                                connected_cars[i].queue = connected_cars[i].queue->next;
-                                free(temp);
-
-                                // Recalculate peak after popping
-                                if (connected_cars[i].queue != NULL)
-                                {
-                                    // Find new peak in remaining queue
-                                    int new_peak = connected_cars[i].queue->floor;
-                                    Node *curr = connected_cars[i].queue;
-                                    while (curr != NULL)
-                                    {
-                                        if (curr->floor > new_peak)
-                                        {
-                                            new_peak = curr->floor;
-                                        }
-                                        curr = curr->next;
-                                    }
-                                    connected_cars[i].peak_floor = new_peak;
-                                }
-                                else
-                                {
-                                    // Queue is empty, reset peak to current floor
-                                    connected_cars[i].peak_floor = floor_to_int(current);
-                                }
-
-                                // Send next floor if there is one
-                                if (connected_cars[i].queue != NULL)
-                                {
-                                    char floor_str[4];
-                                    int_to_floor(connected_cars[i].queue->floor, floor_str);
-
-                                    char floor_msg[BUFFER_SIZE];
-                                    sprintf(floor_msg, "FLOOR %s", floor_str);
-                                    uint16_t len = strlen(floor_msg);
-                                    uint16_t net_len = htons(len);
-                                    send(sockfd, &net_len, sizeof(net_len), 0);
-                                    send(sockfd, floor_msg, len, 0);
-
-                                    printf("Sent next FLOOR %s to car %s\n", floor_str, connected_cars[i].name);
-                                }
-                            }
-                        }
-                        break;
-                    }
-                }
-                pthread_mutex_unlock(&cars_mutex);
+        pthread_mutex_lock(&pool.mutex);
+        if (pool.count == POOL_QUEUE_CAPACITY)
+        {
+            // Back-pressure: further clients wait in the kernel's listen backlog
+            pool.full_waits++;
+            while (pool.count == POOL_QUEUE_CAPACITY)
+            {
+                pthread_cond_wait(&pool.not_full, &pool.mutex);
             }
         }
+        pool.jobs[(pool.head + pool.count) % POOL_QUEUE_CAPACITY] = clientfd;
+        pool.count++;
+        pool.submitted++;
+        if (pool.count > pool.peak_queued)
+        {
+            pool.peak_queued = pool.count;
+        }
+        pthread_cond_signal(&pool.not_empty);
+        pthread_mutex_unlock(&pool.mutex);
     }
-    else if (strncmp(buffer, "CALL", 4) == 0)
-    {
-        char source[4], dest[4];
-        sscanf(buffer, "%*s %3s %3s", source, dest);
-        handleCallRequest(source, dest, sockfd);
-    }
-    else
+
+    return 0;
+}
+
+// runThreadPerConnection: legacy mode, accept loop spawns a detached thread per socket
+int runThreadPerConnection(void)
+{
+    while (1)
     {
-        const char *reply = "ERROR Unknown command";
-        uint16_t len = strlen(reply);
-        uint16_t net_len = htons(len);
-        send(sockfd, &net_len, sizeof(net_len), 0);
-        send(sockfd, reply, len, 0);
+        int clientfd = acceptClient();
+
+        logInfo("Accepted a new connection.\n");
+
+        Connection *conn = newConnection(clientfd);
+        conn->wakefd = eventfd(0, 0);
+        pthread_t thread;
+        pthread_create(&thread, NULL, handleConnection, conn);
+        pthread_detach(thread);
     }
 
-    close(sockfd);
-    return NULL;
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 1)
+    int use_threads = 0;
+    int pool_workers = 0;
+    const char *unix_path = NULL;
+    int batch_window = 0;
+    int latency_dump = 0;
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "Usage: %s (no arguments)\n", argv[0]);
+        if (strcmp(argv[i], "--threads") == 0)
+        {
+            use_threads = 1;
+        }
+        else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            pool_workers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--coarse-lock") == 0)
+        {
+            coarse_locking = 1; // One lock for all cars, as before fine-grained locking
+        }
+        else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc)
+        {
+            unix_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc &&
+                 atoi(argv[i + 1]) > 0 && atoi(argv[i + 1]) <= MAX_BATCH_WINDOW_MS)
+        {
+            batch_window = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--group") == 0)
+        {
+            dispatch_mode = DISPATCH_GROUP; // Destination grouping
+        }
+        else if (strcmp(argv[i], "--zones") == 0)
+        {
+            zoning_enabled = 1;
+        }
+        else if (strcmp(argv[i], "--adaptive") == 0)
+        {
+            traffic_adaptive = 1; // Picks the dispatch mode and zoning as traffic changes
+        }
+        else if (strcmp(argv[i], "--park") == 0)
+        {
+            parking_enabled = 1;
+        }
+        else if (strcmp(argv[i], "--coalesce") == 0)
+        {
+            coalesce_enabled = 1;
+        }
+        else if (strcmp(argv[i], "--transfers") == 0)
+        {
+            transfers_enabled = 1;
+        }
+        else if (strcmp(argv[i], "--latency-dump") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            latency_dump = atoi(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--threads | --pool <workers>] [--coarse-lock] [--unix <path>] [--batch <ms>] [--group] [--zones] [--adaptive] [--park] [--coalesce] [--transfers] [--latency-dump <seconds>]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // A call pad hanging up before its reply arrives must not kill the controller
+    signal(SIGPIPE, SIG_IGN);
+
+    if (logStart() != 0)
+    {
+        perror("logStart");
         return 1;
     }
+    if (lockstatInit("controller") != 0)
+    {
+        perror("lockstatInit");
+    }
+    else if (lockstat_region != NULL)
+    {
+        printf("Recording lock statistics for ./lockreport\n");
+    }
+    registryInit();
 
-    for (int i = 0; i < 10; i++)
+    if (batch_window > 0)
+    {
+        if (batchStart(batch_window) != 0)
+        {
+            perror("batchStart");
+            return 1;
+        }
+        printf("Assigning calls in batches every %d ms\n", batch_window);
+    }
+    if (traffic_adaptive)
+    {
+        trafficInit();
+        printf("Switching dispatch policy with the traffic pattern\n");
+    }
+    else if (dispatch_mode == DISPATCH_GROUP)
+    {
+        printf("Grouping passengers by destination\n");
+    }
+    if (zoning_enabled && !traffic_adaptive)
     {
-        connected_cars[i].is_active = 0;
-        connected_cars[i].queue = NULL;
-        connected_cars[i].peak_floor = 0;
+        zoningInit();
+        printf("Zoning the building by demand\n");
+    }
+    if (parking_enabled)
+    {
+        parkingInit();
+        printf("Parking idle cars where calls are expected\n");
+    }
+    if (coalesce_enabled)
+    {
+        printf("Coalescing hall calls into open pickups\n");
+    }
+    if (transfers_enabled)
+    {
+        printf("Routing calls through transfer floors when no one car serves both\n");
+    }
+    if (latency_dump > 0)
+    {
+        if (latencyDumpStart(latency_dump) != 0)
+        {
+            perror("latencyDumpStart");
+            return 1;
+        }
+        printf("Printing call latencies every %d s\n", latency_dump);
     }
 
     int listenfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -594,29 +1329,32 @@ int main(int argc, char *argv[])
         perror("listen");
         return 1;
     }
+    listen_fds[num_listen_fds++] = listenfd;
 
-    printf("Controller is listening on port %d...\n", CONTROLLER_PORT);
-
-    while (1)
+    if (unix_path != NULL)
     {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-
-        int clientfd = accept(listenfd, (struct sockaddr *)&client_addr, &client_len);
-        if (clientfd == -1)
+        int unixfd = endpointListenUnix(unix_path, BACKLOG);
+        if (unixfd == -1)
         {
-            perror("accept");
-            continue;
+            perror(unix_path);
+            return 1;
         }
+        listen_fds[num_listen_fds++] = unixfd;
+        printf("Controller is also listening on unix:%s\n", unix_path);
+    }
 
-        printf("Accepted a new connection.\n");
-
-        int *sockfd_ptr = malloc(sizeof(int));
-        *sockfd_ptr = clientfd;
-        pthread_t thread;
-        pthread_create(&thread, NULL, handleConnection, sockfd_ptr);
-        pthread_detach(thread);
+    if (pool_workers > 0)
+    {
+        printf("Controller is listening on port %d (worker pool of %d)...\n", CONTROLLER_PORT, pool_workers);
+        return runWorkerPool(pool_workers);
     }
 
-    return 0;
-}
\ No newline at end of file
+    printf("Controller is listening on port %d (%s)...\n", CONTROLLER_PORT,
+           use_threads ? "thread per connection" : "event loop");
+
+    if (use_threads)
+    {
+        return runThreadPerConnection();
+    }
+    return runEventLoop();
+}
@@ -0,0 +1,945 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "zoning.h"
+#include "traffic.h"
+#include "parking.h"
+#include "transfer.h"
+#include "latency.h"
+#include "log.h"
+
+int floor_to_int(const char *floor_str)
+{
+    if (floor_str[0] == 'B')
+    {
+        return -atoi(&floor_str[1]);
+    }
+    else
+    {
+        return atoi(floor_str);
+    }
+}
+
+void int_to_floor(int floor_num, char *floor_str)
+{
+    if (floor_num < 0)
+    {
+        sprintf(floor_str, "B%d", -floor_num);
+    }
+    else
+    {
+        sprintf(floor_str, "%d", floor_num);
+    }
+}
+
+int is_floor_valid(const char *floor_str)
+{
+    const char *digits = floor_str[0] == 'B' ? &floor_str[1] : floor_str;
+    size_t len = strlen(digits);
+    if (len == 0 || len > (digits == floor_str ? 3 : 2))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isdigit((unsigned char)digits[i]))
+        {
+            return 0;
+        }
+    }
+    return atoi(digits) >= 1;
+}
+
+// addCallToRoute: SCAN insertion of a call's floors into a car's route. Called with the car's
+// lock held, or on a private copy of the car when planning a batch.
+static void addCallToRoute(Car *car, int source, int dest)
+{
+    // Determine effective floor (where car actually is or is going)
+    int effective_floor;
+    if (car->status == CAR_CLOSING || car->status == CAR_BETWEEN)
+    {
+        effective_floor = car->destination_floor;
+    }
+    else
+    {
+        effective_floor = car->current_floor;
+    }
+
+    // If queue is empty, initialize peak to effective floor
+    if (stopSetCount(&car->stops) == 0)
+    {
+        car->peak_floor = effective_floor;
+    }
+
+    // Determine car's direction based on actual movement
+    int car_current = car->current_floor;
+    int car_dest = car->destination_floor;
+    int is_going_up = (car_dest > car_current);
+    int is_going_down = (car_dest < car_current);
+
+    // Determine if source is ahead or behind the car
+    int source_ahead = 0;
+
+    if (is_going_up)
+    {
+        source_ahead = (source >= effective_floor);
+    }
+    else if (is_going_down)
+    {
+        source_ahead = (source <= effective_floor);
+    }
+    else
+    {
+        // Idle - any source is "ahead"
+        source_ahead = 1;
+    }
+
+    // Determine if we're at/past the peak
+    int at_or_past_peak = (car_current >= car->peak_floor);
+
+    // Insert source floor
+    if (!stopSetContains(&car->stops, source))
+    {
+        if (source > car->peak_floor ||
+            (source_ahead && !at_or_past_peak))
+        {
+            // Source is a new peak, or ahead and below the peak - insert in ascent
+            stopSetAddAscent(&car->stops, source);
+        }
+        else
+        {
+            // Source is behind OR we're past the peak - insert in descent
+            stopSetAddDescent(&car->stops, source);
+        }
+    }
+
+    // Insert destination floor (always goes in descent/after the journey)
+    stopSetAddDescent(&car->stops, dest);
+    car->park_checked = 0;
+
+    if (stopSetCount(&car->stops) > 0)
+    {
+        car->peak_floor = stopSetPeak(&car->stops);
+    }
+}
+
+// sendNextStop: send a new FLOOR if the car's next stop changed. Called with the car's lock held.
+static void sendNextStop(Car *car)
+{
+    if (stopSetCount(&car->stops) > 0)
+    {
+        int first_floor_in_queue = stopSetHead(&car->stops);
+        int current_destination = car->destination_floor;
+
+        // Send FLOOR message if:
+        // 1. Destination changed, OR
+        // 2. Car is already at this floor but doors are closed (need to reopen)
+        if (first_floor_in_queue != current_destination ||
+            (first_floor_in_queue == current_destination &&
+             car->status == CAR_CLOSED))
+        {
+            char floor_str[4];
+            int_to_floor(first_floor_in_queue, floor_str);
+            sendFloorToCar(car, first_floor_in_queue);
+
+            logInfo("Sent FLOOR %s to car %s\n", floor_str, car->name);
+        }
+    }
+}
+
+int coalesce_enabled = 0;
+
+// Open pickups for --coalesce: the car last given a call from each floor in each direction
+// (0 down, 1 up), until it opens there. Only a hint: joinOpenPickup() checks that the car still
+// owes that pickup before joining it. Cars are never freed while the controller runs, so a
+// stale entry is harmless.
+static pthread_mutex_t pickups_mutex = PTHREAD_MUTEX_INITIALIZER; // After any car lock
+static Car *open_pickups[STOP_FLOORS][2];
+static unsigned long coalesce_calls = 0;  // Calls looked up
+static unsigned long coalesce_merged = 0; // Calls that joined an open pickup
+
+// The rest of a multi-leg trip (--transfers). It rides on the call for the leg before, and the
+// next leg is only booked when that leg's car opens at the transfer floor, so the next car isn't
+// sent there (and away again, empty) before the passenger has arrived.
+typedef struct OnwardTrip
+{
+    int next;                          // Leg to book next
+    int num_legs;
+    int floors[TRANSFER_MAX_LEGS + 1]; // As in TransferRoute
+    char cars[TRANSFER_MAX_LEGS][50];  // Car each leg was costed on, by name: its slot may be reused
+    struct OnwardTrip *next_released;  // settleCalls()' list of trips whose next leg is due
+} OnwardTrip;
+
+void dispatchInit(void)
+{
+    pthread_mutex_lock(&pickups_mutex);
+    memset(open_pickups, 0, sizeof(open_pickups));
+    coalesce_calls = coalesce_merged = 0;
+    pthread_mutex_unlock(&pickups_mutex);
+}
+
+// ownCall: record that a car has taken a call made at latency_clock() time called (-1 if its wait
+// isn't to be timed). Called with the car's lock held, on the real car (never a batch plan's copy,
+// which shares the calls array).
+static void ownCall(Car *car, int source, int dest, long called)
+{
+    if (car->num_calls == car->calls_capacity)
+    {
+        car->calls_capacity = car->calls_capacity > 0 ? car->calls_capacity * 2 : 8;
+        car->calls = realloc(car->calls, car->calls_capacity * sizeof(CarCall));
+    }
+    CarCall *call = &car->calls[car->num_calls++];
+    call->source = source;
+    call->dest = dest;
+    call->picked_up = 0;
+    call->called_us = called;
+    call->picked_up_us = -1;
+    call->onward = NULL;
+
+    if (coalesce_enabled)
+    {
+        pthread_mutex_lock(&pickups_mutex);
+        open_pickups[source - STOP_MIN_FLOOR][dest > source] = car;
+        pthread_mutex_unlock(&pickups_mutex);
+    }
+}
+
+// settleCalls: a car has opened its doors at floor - passengers for it get out, and those
+// waiting there get in. Trips whose passengers get out here to change cars are added to
+// *released, for bookOnward() once the car's lock is dropped. Called with the car's lock held.
+static void settleCalls(Car *car, int floor, OnwardTrip **released)
+{
+    long now = latency_clock();
+    int i = 0;
+    while (i < car->num_calls)
+    {
+        CarCall *call = &car->calls[i];
+        if (call->picked_up && call->dest == floor)
+        {
+            latencyRecord(car, LATENCY_RIDE, now - call->picked_up_us);
+            if (call->onward != NULL)
+            {
+                call->onward->next_released = *released;
+                *released = call->onward;
+            }
+            *call = car->calls[--car->num_calls]; // Finished; look at the one moved in next
+            continue;
+        }
+        if (!call->picked_up && call->source == floor)
+        {
+            call->picked_up = 1;
+            call->picked_up_us = now;
+            if (call->called_us >= 0)
+            {
+                latencyRecord(car, LATENCY_WAIT, now - call->called_us);
+            }
+            if (coalesce_enabled)
+            {
+                pthread_mutex_lock(&pickups_mutex);
+                Car **pickup = &open_pickups[floor - STOP_MIN_FLOOR][call->dest > floor];
+                if (*pickup == car)
+                {
+                    *pickup = NULL;
+                }
+                pthread_mutex_unlock(&pickups_mutex);
+            }
+        }
+        i++;
+    }
+}
+
+// Cost model, in car steps: the car's delay per floor travelled, plus the
+// Opening, Open and Closing steps at every stop.
+#define FLOOR_TIME 1
+#define STOP_TIME 3
+
+// Destination grouping: cost of each stop a call adds to a car's route
+#define GROUP_STOP_PENALTY (2 * STOP_TIME)
+
+DispatchMode dispatch_mode = DISPATCH_ETA;
+
+// timeAlongRoute: follow a route from floor `from` (reached at time t) through its stops and
+// return when the car reaches target. That is on the way if target lies on a leg heading in
+// direction dir (or dir is 0), else after the route's last stop. The cursor is left at the
+// first stop still ahead once the car is at target, so the search can continue from there.
+static int timeAlongRoute(int from, int t, const StopSet *stops, StopCursor *cursor,
+                          int target, int dir)
+{
+    int prev = from;
+    StopCursor before = *cursor;
+    int stop;
+    while (stopSetNext(stops, cursor, &stop))
+    {
+        int leg = stop - prev;
+        int heading = (leg > 0) - (leg < 0);
+        int low = leg > 0 ? prev : stop;
+        int high = leg > 0 ? stop : prev;
+
+        if (target >= low && target <= high &&
+            (dir == 0 || heading == 0 || heading == dir || target == stop))
+        {
+            if (target != stop)
+            {
+                *cursor = before; // Still has to make this stop
+            }
+            return t + abs(target - prev) * FLOOR_TIME;
+        }
+        t += abs(leg) * FLOOR_TIME + STOP_TIME;
+        prev = stop;
+        before = *cursor;
+    }
+
+    return t + abs(target - prev) * FLOOR_TIME;
+}
+
+// estimateTimes: time until a car taking this call would have delivered the passenger to dest,
+// given where it is, what its doors are doing and the stops it already has, and in *pickup
+// when it would have reached them at source. Called with the car's lock held.
+static int estimateTimes(const Car *car, int source, int dest, int *pickup)
+{
+    int from = car->current_floor;
+    int t = 0;
+
+    switch (car->status)
+    {
+    case CAR_BETWEEN:
+    case CAR_CLOSING:
+        // Committed to its destination floor
+        from = car->destination_floor;
+        t = abs(car->destination_floor - car->current_floor) * FLOOR_TIME;
+        break;
+    case CAR_OPENING:
+        t = STOP_TIME - 1;
+        break;
+    case CAR_OPEN:
+        t = STOP_TIME - 2;
+        break;
+    default:
+        break;
+    }
+
+    int dir = (dest > source) - (dest < source);
+    StopCursor cursor;
+    stopSetBegin(&car->stops, &cursor);
+    *pickup = timeAlongRoute(from, t, &car->stops, &cursor, source, dir);
+    return timeAlongRoute(source, *pickup + STOP_TIME, &car->stops, &cursor, dest, dir);
+}
+
+// estimateCost: estimateTimes() without the pickup time
+static int estimateCost(const Car *car, int source, int dest)
+{
+    int pickup;
+    return estimateTimes(car, source, dest, &pickup);
+}
+
+// callPenalty: what giving a call to a car costs on top of its estimated time, under the
+// current dispatch mode, and for a car kept to a zone by --zones.
+// Called with the car's lock held.
+static int callPenalty(const Car *car, int source, int dest)
+{
+    int cost = 0;
+
+    if (__atomic_load_n(&dispatch_mode, __ATOMIC_RELAXED) == DISPATCH_GROUP)
+    {
+        // Every stop a call adds holds up everyone else in the car, so prefer a car that
+        // already stops at source, and one already heading to (or near) dest
+        if (!stopSetContains(&car->stops, source))
+        {
+            cost += GROUP_STOP_PENALTY;
+        }
+        if (!stopSetContains(&car->stops, dest))
+        {
+            cost += GROUP_STOP_PENALTY;
+            int spread = stopSetDistance(&car->stops, dest);
+            if (spread > 0)
+            {
+                cost += spread * FLOOR_TIME;
+            }
+        }
+    }
+    if (__atomic_load_n(&zoning_enabled, __ATOMIC_RELAXED) && stopSetCount(&car->stops) > 0)
+    {
+        // A busy car sent outside its zone keeps its own passengers waiting there and back.
+        // An idle car isn't holding anyone up, so it can go wherever it is needed.
+        cost += 2 * zoningDistance(car, source, dest) * FLOOR_TIME;
+    }
+    return cost;
+}
+
+// callCost: what giving a call to a car costs, its estimated time plus callPenalty().
+// Called with the car's lock held.
+static int callCost(const Car *car, int source, int dest)
+{
+    return estimateCost(car, source, dest) + callPenalty(car, source, dest);
+}
+
+// legCost: callCost() for a passenger who only reaches source at time ready (a later leg of a
+// trip): the car can't leave with them before then. Sets *done to when they'd reach dest.
+// Called with the car's lock held.
+static int legCost(const Car *car, int source, int dest, int ready, int *done)
+{
+    int pickup;
+    int delivered = estimateTimes(car, source, dest, &pickup);
+    *done = (pickup > ready ? pickup : ready) + (delivered - pickup);
+    return *done + callPenalty(car, source, dest);
+}
+
+// joinOpenPickup: for --coalesce, add a call to the car already on its way to pick someone up
+// at source heading the same way, if it can reach dest. The source stop is already in its
+// route, so only the drop-off is added. Only a hall_call (not a call being reassigned from a
+// car that left service) counts towards coalesceDescribe()'s rate. Called with the registry
+// lock held. Copies the car's name into car_name; returns 1 if the call joined, else 0.
+static int joinOpenPickup(int source, int dest, long called, int hall_call, char *car_name)
+{
+    int up = dest > source;
+    pthread_mutex_lock(&pickups_mutex);
+    Car *car = open_pickups[source - STOP_MIN_FLOOR][up];
+    if (hall_call)
+        coalesce_calls++;
+    pthread_mutex_unlock(&pickups_mutex);
+
+    if (car == NULL || !car->is_active || dest < car->lowest_floor || dest > car->highest_floor)
+        return 0;
+
+    lockCar(car);
+    int owed = 0;
+    for (int i = 0; i < car->num_calls && !owed; i++)
+    {
+        const CarCall *call = &car->calls[i];
+        owed = !call->picked_up && call->source == source && (call->dest > source) == up;
+    }
+    if (owed)
+    {
+        addCallToRoute(car, source, dest);
+        ownCall(car, source, dest, called);
+        sendNextStop(car);
+        strcpy(car_name, car->name);
+    }
+    unlockCar(car);
+
+    if (owed && hall_call)
+    {
+        pthread_mutex_lock(&pickups_mutex);
+        coalesce_merged++;
+        pthread_mutex_unlock(&pickups_mutex);
+    }
+    return owed;
+}
+
+// cheapestCar: the car with the lowest legCost() for a passenger at source from time ready (0
+// for a hall call, so callCost()) among those that can reach both floors (fixed while the
+// registry lock is held), the earliest registered on a tie; NULL if there is none. Sets
+// *best_done to when that car would deliver them. eligible is scratch space for num_cars cars
+// (eligibleScratch()). Called with the registry lock held.
+static Car *cheapestCar(int source, int dest, int ready, Car **eligible, int *best_cost, int *best_done)
+{
+    int num_eligible = findEligibleCars(source, dest, eligible);
+
+    Car *best = NULL;
+    *best_cost = *best_done = 0;
+    for (int i = 0; i < num_eligible; i++)
+    {
+        Car *car = eligible[i];
+        int done;
+        lockCar(car);
+        int cost = legCost(car, source, dest, ready, &done);
+        unlockCar(car);
+
+        if (best == NULL || cost < *best_cost)
+        {
+            best = car;
+            *best_cost = cost;
+            *best_done = done;
+        }
+    }
+    return best;
+}
+
+// assignCall: give a call to the eligible car with the lowest callCost() - by default its
+// estimated wait plus ride time - (the earliest registered on a tie) and add its floors to that
+// car's route.
+// Copies the chosen car's name into car_name; returns 0, or -1 if no car can take the call.
+int assignCall(int source, int dest, char *car_name)
+{
+    long called = latency_clock();
+    if (traffic_adaptive)
+    {
+        trafficRecordCall(source, dest);
+    }
+    if (__atomic_load_n(&zoning_enabled, __ATOMIC_RELAXED))
+    {
+        zoningRecordCall(source, dest);
+    }
+    if (parking_enabled)
+    {
+        parkingRecordCall(source);
+    }
+    registryReadLock();
+
+    if (coalesce_enabled && joinOpenPickup(source, dest, called, 1, car_name))
+    {
+        registryUnlock();
+        return 0;
+    }
+
+    int best_cost, best_done;
+    Car *best = cheapestCar(source, dest, 0, eligibleScratch(), &best_cost, &best_done);
+
+    if (best == NULL)
+    {
+        registryUnlock();
+        return -1;
+    }
+
+    lockCar(best);
+    addCallToRoute(best, source, dest);
+    ownCall(best, source, dest, called);
+    sendNextStop(best);
+    strcpy(car_name, best->name);
+    unlockCar(best);
+    registryUnlock();
+    return 0;
+}
+
+// Time to change cars: the passenger gets out before the next car can take them on. That car's
+// stop for them is part of its own estimate.
+#define TRANSFER_TIME STOP_TIME
+
+int assignTrip(int source, int dest, long called, char *reply, size_t size)
+{
+    TransferRoute routes[TRANSFER_MAX_ROUTES];
+    Car *legs[TRANSFER_MAX_LEGS];
+    Car *best_legs[TRANSFER_MAX_LEGS];
+    int best = -1, best_cost = 0;
+
+    registryReadLock();
+    int num_routes = transferRoutes(source, dest, routes, TRANSFER_MAX_ROUTES);
+    Car **eligible = eligibleScratch();
+    for (int r = 0; r < num_routes; r++)
+    {
+        // Each leg starts once the passenger is off the one before, or when its car gets
+        // there if that is later; only each car's penalties add up independently
+        const TransferRoute *route = &routes[r];
+        int ready = 0, penalties = 0;
+        int l;
+        for (l = 0; l < route->num_legs; l++)
+        {
+            int cost, done;
+            legs[l] = cheapestCar(route->floors[l], route->floors[l + 1], ready, eligible, &cost, &done);
+            if (legs[l] == NULL)
+                break;
+            penalties += cost - done;
+            ready = done + TRANSFER_TIME;
+        }
+        if (l < route->num_legs)
+            continue; // A range with no car left in it
+        int total = ready - TRANSFER_TIME + penalties;
+
+        // Fewer legs on a tie
+        if (best == -1 || total < best_cost ||
+            (total == best_cost && route->num_legs < routes[best].num_legs))
+        {
+            best = r;
+            best_cost = total;
+            memcpy(best_legs, legs, route->num_legs * sizeof(Car *));
+        }
+    }
+
+    if (best == -1)
+    {
+        registryUnlock();
+        return -1;
+    }
+
+    // Book the first leg now; the rest follow the passenger (see bookOnward())
+    const TransferRoute *route = &routes[best];
+    OnwardTrip *trip = malloc(sizeof(OnwardTrip));
+    trip->next = 1;
+    trip->num_legs = route->num_legs;
+    memcpy(trip->floors, route->floors, sizeof(trip->floors));
+    for (int l = 0; l < route->num_legs; l++)
+    {
+        strcpy(trip->cars[l], best_legs[l]->name);
+    }
+
+    Car *first = best_legs[0];
+    lockCar(first);
+    addCallToRoute(first, route->floors[0], route->floors[1]);
+    ownCall(first, route->floors[0], route->floors[1], called);
+    first->calls[first->num_calls - 1].onward = trip;
+    sendNextStop(first);
+    unlockCar(first);
+
+    size_t len = 0;
+    for (int l = 0; l < route->num_legs; l++)
+    {
+        if (l > 0)
+        {
+            char floor_str[8];
+            int_to_floor(route->floors[l], floor_str);
+            len += snprintf(reply + len, len < size ? size - len : 0, " %s ", floor_str);
+        }
+        len += snprintf(reply + len, len < size ? size - len : 0, "%s", best_legs[l]->name);
+    }
+    registryUnlock();
+    return route->num_legs;
+}
+
+// bookOnward: a trip's passenger has got out at a transfer floor; give the next leg to the car
+// it was planned on, or to the cheapest car now if that one has left service or no longer serves
+// both floors. Frees the trip once its last leg is booked. Called with the registry lock held and
+// no car's lock.
+static void bookOnward(OnwardTrip *trip)
+{
+    int source = trip->floors[trip->next];
+    int dest = trip->floors[trip->next + 1];
+    Car *car = findCarByName(trip->cars[trip->next]);
+    if (car == NULL || !car->is_active || car->lowest_floor > (source < dest ? source : dest) ||
+        car->highest_floor < (source > dest ? source : dest))
+    {
+        int cost, done;
+        car = cheapestCar(source, dest, 0, eligibleScratch(), &cost, &done);
+    }
+    if (car == NULL)
+    {
+        char dest_str[8];
+        int_to_floor(dest, dest_str);
+        logWarn("No car left to take a passenger changing cars on to %s\n", dest_str);
+        free(trip);
+        return;
+    }
+
+    trip->next++;
+    int last = (trip->next == trip->num_legs);
+    lockCar(car);
+    addCallToRoute(car, source, dest);
+    ownCall(car, source, dest, -1); // Changes aren't calls
+    car->calls[car->num_calls - 1].onward = last ? NULL : trip;
+    sendNextStop(car);
+    char source_str[8];
+    int_to_floor(source, source_str);
+    logInfo("Booked car %s for a passenger changing cars at %s\n", car->name, source_str);
+    unlockCar(car);
+    if (last)
+    {
+        free(trip);
+    }
+}
+
+// cheapestCars: the cheapest and second cheapest car for call i, -1 where there is none
+static void cheapestCars(const int *cost, int num_active, int i, int *first, int *second)
+{
+    *first = *second = -1;
+    for (int c = 0; c < num_active; c++)
+    {
+        int cc = cost[i * num_active + c];
+        if (cc < 0)
+            continue;
+        if (*first == -1 || cc < cost[i * num_active + *first])
+        {
+            *second = *first;
+            *first = c;
+        }
+        else if (*second == -1 || cc < cost[i * num_active + *second])
+        {
+            *second = c;
+        }
+    }
+}
+
+// planBatch: assign calls together, then send each car that got any of them one FLOOR for its
+// new next stop. Calls are placed one at a time on copies of the cars' routes, always taking
+// next the call that would lose most by missing its cheapest car (its regret), and re-costing
+// the remaining calls on the car that just changed. Contested calls so get first pick, instead
+// of whichever happened to arrive first.
+// hall_calls is 0 for calls being reassigned, which coalescing doesn't count.
+// Fills in each call's car_name ("" if no car can take it); returns the number assigned.
+static int planBatch(BatchCall *calls, int count, int hall_calls)
+{
+    if (count == 0)
+        return 0;
+
+    registryReadLock();
+
+    // Calls that can join a car already stopping for someone are settled before planning
+    int joined = 0;
+    for (int i = 0; i < count; i++)
+    {
+        calls[i].car_name[0] = '\0';
+        if (coalesce_enabled && joinOpenPickup(calls[i].source, calls[i].dest, calls[i].called, hall_calls,
+                                               calls[i].car_name))
+        {
+            joined++;
+        }
+    }
+
+    // Plan on plain copies (the copied mutexes are never used) so STATUS updates aren't held up
+    Car **cars = malloc(num_cars * sizeof(Car *));
+    Car *plans = malloc(num_cars * sizeof(Car));
+    int num_active = 0;
+    for (int i = 0; i < num_cars; i++)
+    {
+        Car *car = connected_cars[i];
+        if (!car->is_active)
+            continue;
+        lockCar(car);
+        plans[num_active] = *car;
+        unlockCar(car);
+        cars[num_active++] = car;
+    }
+
+    // cost[i * num_active + c] for call i on car c, -1 if the car can't reach both floors
+    int *cost = malloc((size_t)count * num_active * sizeof(int));
+    int *chosen = malloc(count * sizeof(int));
+    int *order = malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        int already = calls[i].car_name[0] != '\0';
+        chosen[i] = already ? -2 : -1; // Not planned again if it joined a car
+        for (int c = 0; c < num_active; c++)
+        {
+            const Car *car = &plans[c];
+            int eligible = !already && calls[i].source >= car->lowest_floor && calls[i].source <= car->highest_floor &&
+                           calls[i].dest >= car->lowest_floor && calls[i].dest <= car->highest_floor;
+            cost[i * num_active + c] = eligible ? callCost(car, calls[i].source, calls[i].dest) : -1;
+        }
+    }
+
+    int assigned = 0;
+    while (1)
+    {
+        int pick = -1, pick_car = -1, pick_regret = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (chosen[i] != -1)
+                continue;
+            int first, second;
+            cheapestCars(cost, num_active, i, &first, &second);
+            if (first == -1)
+                continue; // No car can take it
+
+            int regret = second == -1 ? INT_MAX : cost[i * num_active + second] - cost[i * num_active + first];
+            if (pick == -1 || regret > pick_regret ||
+                (regret == pick_regret && cost[i * num_active + first] < cost[pick * num_active + pick_car]))
+            {
+                pick = i;
+                pick_car = first;
+                pick_regret = regret;
+            }
+        }
+        if (pick == -1)
+            break;
+
+        chosen[pick] = pick_car;
+        order[assigned++] = pick;
+        addCallToRoute(&plans[pick_car], calls[pick].source, calls[pick].dest);
+
+        // Only the chosen car's route changed
+        for (int i = 0; i < count; i++)
+        {
+            if (chosen[i] == -1 && cost[i * num_active + pick_car] >= 0)
+            {
+                cost[i * num_active + pick_car] = callCost(&plans[pick_car], calls[i].source, calls[i].dest);
+            }
+        }
+    }
+
+    // Apply the plan to the real cars, in the order it was made, one FLOOR per car
+    for (int c = 0; c < num_active; c++)
+    {
+        int touched = 0;
+        for (int k = 0; k < assigned; k++)
+        {
+            int i = order[k];
+            if (chosen[i] != c)
+                continue;
+            if (!touched)
+            {
+                lockCar(cars[c]);
+                touched = 1;
+            }
+            addCallToRoute(cars[c], calls[i].source, calls[i].dest);
+            ownCall(cars[c], calls[i].source, calls[i].dest, calls[i].called);
+            strcpy(calls[i].car_name, cars[c]->name);
+        }
+        if (touched)
+        {
+            sendNextStop(cars[c]);
+            unlockCar(cars[c]);
+        }
+    }
+    registryUnlock();
+
+    free(cars);
+    free(plans);
+    free(cost);
+    free(chosen);
+    free(order);
+    return assigned + joined;
+}
+
+// assignBatch: assign a window's worth of calls from passengers (see planBatch()), after letting
+// --adaptive, --zones and --park learn from them
+int assignBatch(BatchCall *calls, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (traffic_adaptive)
+            trafficRecordCall(calls[i].source, calls[i].dest);
+        if (__atomic_load_n(&zoning_enabled, __ATOMIC_RELAXED))
+            zoningRecordCall(calls[i].source, calls[i].dest);
+        if (parking_enabled)
+            parkingRecordCall(calls[i].source);
+    }
+    return planBatch(calls, count, 1);
+}
+
+void updateCarStatus(int sockfd, CarStatus status, int current, int dest)
+{
+    registryReadLock();
+    Car *car = findCarBySocket(sockfd);
+    if (car == NULL)
+    {
+        registryUnlock();
+        return;
+    }
+
+    lockCar(car);
+    car->status = status;
+    car->current_floor = current;
+    car->destination_floor = dest;
+
+    // Car arrived at a floor - pop from queue and send next
+    OnwardTrip *released = NULL;
+    if (status == CAR_OPENING && current == dest)
+    {
+        settleCalls(car, current, &released);
+        if (stopSetCount(&car->stops) > 0)
+        {
+            stopSetPop(&car->stops);
+
+            if (stopSetCount(&car->stops) > 0)
+            {
+                car->peak_floor = stopSetPeak(&car->stops);
+
+                // Send next floor
+                int next = stopSetHead(&car->stops);
+                char floor_str[4];
+                int_to_floor(next, floor_str);
+                sendFloorToCar(car, next);
+
+                logInfo("Sent next FLOOR %s to car %s\n", floor_str, car->name);
+            }
+            else
+            {
+                // Queue is empty, reset peak to current floor
+                car->peak_floor = current;
+            }
+        }
+    }
+    else if (status == CAR_CLOSED && current == dest && stopSetCount(&car->stops) > 0 &&
+             stopSetHead(&car->stops) == current)
+    {
+        // A call for this floor came in while the doors were closing, and the car only reopens
+        // for a FLOOR that arrives once it is Closed
+        sendFloorToCar(car, current);
+        logInfo("Sent FLOOR again to car %s to reopen\n", car->name);
+    }
+    int idle = status == CAR_CLOSED && current == dest && stopSetCount(&car->stops) == 0;
+    unlockCar(car);
+
+    while (released != NULL)
+    {
+        OnwardTrip *trip = released;
+        released = trip->next_released;
+        bookOnward(trip);
+    }
+
+    if (parking_enabled && idle)
+    {
+        parkingCarIdle(car);
+    }
+    registryUnlock();
+}
+
+// Totals for reassignDescribe()
+static pthread_mutex_t reassign_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long reassign_cars = 0;     // Cars that left service owing calls
+static unsigned long reassign_moved = 0;    // Calls given to another car
+static unsigned long reassign_stranded = 0; // Calls no remaining car could take
+static double reassign_last_ms = 0;
+static double reassign_max_ms = 0;
+
+void reassignCalls(const char *car_name, const CarCall *calls, int count, int at,
+                   const struct timespec *started)
+{
+    // All at once, as a batch, so each car that takes some gets one FLOOR
+    BatchCall *batch = malloc(count * sizeof(BatchCall));
+    int num_batch = 0;
+    for (int i = 0; i < count; i++)
+    {
+        // A passenger part way through a multi-leg trip is routed afresh to where they're going
+        int source = calls[i].picked_up ? at : calls[i].source;
+        int dest = calls[i].onward != NULL ? calls[i].onward->floors[calls[i].onward->num_legs] : calls[i].dest;
+        free(calls[i].onward);
+        if (source == dest)
+            continue; // Stopped where they were going anyway
+        batch[num_batch].source = source;
+        batch[num_batch].dest = dest;
+        batch[num_batch].called = calls[i].picked_up ? -1 : calls[i].called_us; // Still waiting since then
+        num_batch++;
+    }
+    int moved = planBatch(batch, num_batch, 0);
+    for (int i = 0; transfers_enabled && i < num_batch; i++)
+    {
+        char trip[TRIP_REPLY_SIZE];
+        if (batch[i].car_name[0] == '\0' && assignTrip(batch[i].source, batch[i].dest, batch[i].called, trip, sizeof(trip)) > 0)
+        {
+            moved++;
+        }
+    }
+    int stranded = num_batch - moved;
+    free(batch);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ms = (now.tv_sec - started->tv_sec) * 1e3 + (now.tv_nsec - started->tv_nsec) / 1e6;
+    logInfo("Reassigned %d calls from car %s in %.3f ms (%d could not be taken)\n", moved, car_name, ms,
+            stranded);
+
+    pthread_mutex_lock(&reassign_mutex);
+    reassign_cars++;
+    reassign_moved += moved;
+    reassign_stranded += stranded;
+    reassign_last_ms = ms;
+    if (ms > reassign_max_ms)
+        reassign_max_ms = ms;
+    pthread_mutex_unlock(&reassign_mutex);
+}
+
+void coalesceDescribe(char *buf, size_t size)
+{
+    pthread_mutex_lock(&pickups_mutex);
+    if (!coalesce_enabled)
+    {
+        snprintf(buf, size, "COALESCE disabled");
+    }
+    else
+    {
+        snprintf(buf, size, "COALESCE calls=%lu merged=%lu rate=%.3f", coalesce_calls, coalesce_merged,
+                 coalesce_calls > 0 ? (double)coalesce_merged / coalesce_calls : 0.0);
+    }
+    pthread_mutex_unlock(&pickups_mutex);
+}
+
+void reassignDescribe(char *buf, size_t size)
+{
+    pthread_mutex_lock(&reassign_mutex);
+    snprintf(buf, size, "REASSIGN cars=%lu moved=%lu stranded=%lu last_ms=%.3f max_ms=%.3f", reassign_cars,
+             reassign_moved, reassign_stranded, reassign_last_ms, reassign_max_ms);
+    pthread_mutex_unlock(&reassign_mutex);
+}
@@ -0,0 +1,77 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stddef.h>
+#include <time.h>
+#include "registry.h"
+
+// Floor conversion ("B1" <-> -1)
+int floor_to_int(const char *floor_str);
+void int_to_floor(int floor_num, char *floor_str);
+int is_floor_valid(const char *floor_str); // B99..B1, 1..999
+
+// How assignCall() and assignBatch() weigh up the cars for a call
+typedef enum
+{
+    DISPATCH_ETA,  // Soonest delivery of this passenger
+    DISPATCH_GROUP // Destination grouping: also avoid adding stops, so passengers to nearby
+                   // floors share a car
+} DispatchMode;
+
+// Switched at run time by --adaptive (traffic.c), so once threads are running it is only
+// read and written with __atomic loads and stores; a call costed mid-switch just sees one
+// mode or the other
+extern DispatchMode dispatch_mode;
+
+// Hall-call coalescing (--coalesce): a call from a floor some car is already on its way to,
+// for a passenger going the same way, joins that car - only the drop-off is added to its
+// route - instead of going through dispatch and possibly fetching a second car
+extern int coalesce_enabled;
+
+// dispatchInit: forget the open pickups and coalescing counts (for each simulator run)
+void dispatchInit(void);
+
+int assignCall(int source, int dest, char *car_name);
+
+// assignTrip: for a call no one car can take, book the quickest trip of two or three legs
+// through transfer floors (--transfers, see transfer.h), for a passenger who called at
+// latency_clock() time called (see latency.h). Only the first leg goes to its car now; each
+// later one is booked when the passenger gets out of the car before. Writes the reply's car list into reply,
+// e.g. "Alpha 20 Beta" for Alpha to floor 20 and Beta from there; returns the number of legs,
+// or -1 if there is no such trip.
+#define TRIP_REPLY_SIZE 192 // Three car names and two floors
+int assignTrip(int source, int dest, long called, char *reply, size_t size);
+
+// One call in a batch (see batch.h)
+typedef struct
+{
+    int source;
+    int dest;
+    char car_name[50]; // Set by assignBatch(), empty if no car can take the call
+    long called;       // latency_clock() when the passenger called, -1 if not to be timed
+} BatchCall;
+
+int assignBatch(BatchCall *calls, int count);
+void updateCarStatus(int sockfd, CarStatus status, int current, int dest);
+
+// reassignCalls: give the calls a car owed when it left service (at floor `at`) to the other
+// cars, right away. Passengers still waiting are called again from their floor; those on board
+// get out where the car stopped and are called on from there, to the end of their trip if they
+// were changing cars. Logs how many were moved and how
+// long it took since started. Called without the registry lock held.
+void reassignCalls(const char *car_name, const CarCall *calls, int count, int at,
+                   const struct timespec *started);
+
+// coalesceDescribe: "COALESCE calls=... merged=... rate=..." for STATS, or "COALESCE disabled"
+// Only hall calls count, not calls reassigned from a car that left service
+void coalesceDescribe(char *buf, size_t size);
+
+// reassignDescribe: "REASSIGN cars=... moved=... stranded=... last_ms=... max_ms=..." for STATS
+void reassignDescribe(char *buf, size_t size);
+
+// Provided by the network layer: queue a FLOOR message for a car without
+// blocking, in whichever protocol the car negotiated.
+// Called with the registry lock and the car's lock held.
+void sendFloorToCar(Car *car, int floor);
+
+#endif
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "endpoint.h"
+
+const char *controllerEndpoint(void)
+{
+    const char *endpoint = getenv(CONTROLLER_ENDPOINT_ENV);
+    return (endpoint != NULL && endpoint[0] != '\0') ? endpoint : DEFAULT_CONTROLLER_ENDPOINT;
+}
+
+// unixAddress: fill addr for path, -1 if it is too long for sun_path
+static int unixAddress(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+int endpointConnect(const char *endpoint)
+{
+    if (strncmp(endpoint, "unix:", 5) == 0)
+    {
+        struct sockaddr_un addr;
+        if (unixAddress(endpoint + 5, &addr) == -1)
+        {
+            return -1;
+        }
+        int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sockfd == -1)
+        {
+            return -1;
+        }
+        if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        {
+            int saved = errno;
+            close(sockfd);
+            errno = saved;
+            return -1;
+        }
+        return sockfd;
+    }
+
+    if (strncmp(endpoint, "tcp:", 4) == 0)
+    {
+        endpoint += 4;
+    }
+
+    // host:port, split on the last colon
+    char host[64];
+    const char *colon = strrchr(endpoint, ':');
+    if (colon == NULL || colon == endpoint || (size_t)(colon - endpoint) >= sizeof(host))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, endpoint, colon - endpoint);
+    host[colon - endpoint] = '\0';
+    int port = atoi(colon + 1);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd == -1)
+    {
+        return -1;
+    }
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        int saved = errno;
+        close(sockfd);
+        errno = saved;
+        return -1;
+    }
+    return sockfd;
+}
+
+int endpointListenUnix(const char *path, int backlog)
+{
+    struct sockaddr_un addr;
+    if (unixAddress(path, &addr) == -1)
+    {
+        return -1;
+    }
+
+    // Only ever remove an old socket, never some other file that happens to be there
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        unlink(path);
+    }
+
+    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockfd == -1)
+    {
+        return -1;
+    }
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(sockfd, backlog) == -1)
+    {
+        int saved = errno;
+        close(sockfd);
+        errno = saved;
+        return -1;
+    }
+    return sockfd;
+}
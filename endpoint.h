@@ -0,0 +1,26 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+// Where to find the controller. An endpoint string is one of
+//   host:port       TCP, e.g. "127.0.0.1:3000"
+//   tcp:host:port   the same, spelled out
+//   unix:path       Unix-domain stream socket, e.g. "unix:/tmp/cab-controller.sock"
+// car, call and admin take it from $CONTROLLER_ENDPOINT, defaulting to TCP on
+// port 3000. The controller always listens on TCP and, with --unix <path>,
+// on a socket path as well; co-located processes can then skip loopback TCP.
+
+#define DEFAULT_CONTROLLER_ENDPOINT "127.0.0.1:3000"
+#define CONTROLLER_ENDPOINT_ENV "CONTROLLER_ENDPOINT"
+
+// controllerEndpoint: $CONTROLLER_ENDPOINT if set, else the default
+const char *controllerEndpoint(void);
+
+// endpointConnect: connected stream socket to endpoint, or -1 (errno set,
+// EINVAL if the string can't be parsed)
+int endpointConnect(const char *endpoint);
+
+// endpointListenUnix: listening socket bound to path, replacing a stale
+// socket file from an earlier run. Returns -1 with errno set on failure.
+int endpointListenUnix(const char *path, int backlog);
+
+#endif
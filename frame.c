@@ -0,0 +1,154 @@
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "frame.h"
+
+void frameDecoderInit(FrameDecoder *dec)
+{
+    dec->start = 0;
+    dec->end = 0;
+    dec->holding = 0;
+}
+
+// releaseView: put back the byte the previous view's terminator replaced
+static void releaseView(FrameDecoder *dec)
+{
+    if (dec->holding)
+    {
+        dec->buf[dec->held_pos] = dec->held_byte;
+        dec->holding = 0;
+    }
+}
+
+int frameRead(FrameDecoder *dec, int sockfd, int flags)
+{
+    releaseView(dec);
+
+    // Only a partial frame can be left over, so this moves at most a few bytes
+    if (dec->start > 0)
+    {
+        memmove(dec->buf, dec->buf + dec->start, dec->end - dec->start);
+        dec->end -= dec->start;
+        dec->start = 0;
+    }
+
+    ssize_t n = recv(sockfd, dec->buf + dec->end, FRAME_BUFFER_SIZE - dec->end, flags);
+    if (n == 0)
+    {
+        return FRAME_CLOSED;
+    }
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? FRAME_AGAIN : FRAME_ERROR;
+    }
+    dec->end += n;
+    return FRAME_OK;
+}
+
+int frameNext(FrameDecoder *dec, FrameView *frame)
+{
+    releaseView(dec);
+
+    size_t available = dec->end - dec->start;
+    if (available < sizeof(uint16_t))
+    {
+        return 0;
+    }
+
+    uint16_t net_len;
+    memcpy(&net_len, dec->buf + dec->start, sizeof(net_len));
+    uint16_t len = ntohs(net_len);
+    if (len > FRAME_MAX_PAYLOAD)
+    {
+        return -1;
+    }
+    if (available < sizeof(net_len) + len)
+    {
+        return 0; // Rest of this frame has not arrived yet
+    }
+
+    char *payload = dec->buf + dec->start + sizeof(net_len);
+    dec->start += sizeof(net_len) + len;
+
+    // Terminate in place; the byte after the payload is the next frame's header
+    dec->held_pos = dec->start;
+    dec->held_byte = payload[len];
+    dec->holding = 1;
+    payload[len] = '\0';
+
+    frame->data = payload;
+    frame->len = len;
+    return 1;
+}
+
+size_t frameBuffered(const FrameDecoder *dec)
+{
+    return dec->end - dec->start;
+}
+
+int frameSend(int sockfd, const char *msg, int flags)
+{
+    return frameSendBytes(sockfd, msg, strlen(msg), flags);
+}
+
+int frameSendBytes(int sockfd, const void *data, uint16_t len, int flags)
+{
+    uint16_t net_len = htons(len);
+    struct iovec iov[2] = {
+        {&net_len, sizeof(net_len)},
+        {(void *)data, len},
+    };
+    struct msghdr hdr = {0};
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = 2;
+
+    size_t remaining = sizeof(net_len) + len;
+    while (remaining > 0)
+    {
+        ssize_t n = sendmsg(sockfd, &hdr, flags);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                struct pollfd pfd = {sockfd, POLLOUT, 0};
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return -1;
+        }
+        remaining -= n;
+
+        // Short write: skip whatever went out and send the rest
+        while (hdr.msg_iovlen > 0 && (size_t)n >= hdr.msg_iov->iov_len)
+        {
+            n -= hdr.msg_iov->iov_len;
+            hdr.msg_iov++;
+            hdr.msg_iovlen--;
+        }
+        if (hdr.msg_iovlen > 0)
+        {
+            hdr.msg_iov->iov_base = (char *)hdr.msg_iov->iov_base + n;
+            hdr.msg_iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+ssize_t frameSendBatch(int sockfd, const struct iovec *iov, int iovcnt, int flags)
+{
+    struct msghdr hdr = {0};
+    hdr.msg_iov = (struct iovec *)iov;
+    hdr.msg_iovlen = iovcnt;
+
+    ssize_t n;
+    do
+    {
+        n = sendmsg(sockfd, &hdr, flags);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
@@ -0,0 +1,73 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Streaming decoder for the length-prefixed protocol: every message is a
+// 16-bit network-order length followed by that many bytes of text.
+//
+// Each connection keeps one FrameDecoder. frameRead() pulls whatever the
+// socket has into the buffer with a single recv(), which may hold several
+// frames or only part of one; frameNext() then hands back complete frames
+// one at a time as views into the buffer, without copying. A view's text is
+// NUL-terminated in place and stays valid until the next frameNext() or
+// frameRead() on the same decoder.
+
+#define FRAME_MAX_PAYLOAD 1023 // Longest message either side will accept
+#define FRAME_BUFFER_SIZE 4096 // Room for several frames per recv()
+
+// frameRead results
+#define FRAME_OK 0      // Bytes were added to the buffer
+#define FRAME_AGAIN 1   // Non-blocking read found nothing (or was interrupted)
+#define FRAME_CLOSED 2  // Peer closed the connection
+#define FRAME_ERROR 3   // Socket error, or the peer sent an oversized frame
+
+typedef struct
+{
+    const char *data; // Payload, NUL-terminated in place
+    uint16_t len;
+} FrameView;
+
+typedef struct
+{
+    char buf[FRAME_BUFFER_SIZE + 1]; // +1 so the last frame can be terminated
+    size_t start;                    // First byte not yet handed out
+    size_t end;                      // One past the last byte received
+    size_t held_pos;                 // Byte overwritten by the last view's terminator
+    char held_byte;
+    int holding;
+} FrameDecoder;
+
+void frameDecoderInit(FrameDecoder *dec);
+
+// frameRead: one recv() into the decoder's free space; flags as for recv()
+int frameRead(FrameDecoder *dec, int sockfd, int flags);
+
+// frameNext: 1 with *frame filled in, 0 if no complete frame is buffered,
+// -1 if the next frame is longer than FRAME_MAX_PAYLOAD
+int frameNext(FrameDecoder *dec, FrameView *frame);
+
+// frameBuffered: bytes received but not yet handed out as frames
+size_t frameBuffered(const FrameDecoder *dec);
+
+// Writing. Header and payload always go out in one gather write, so a
+// message costs one syscall, and normally one TCP segment, instead of two.
+
+#define FRAME_BATCH_MAX 64 // Most frames frameSendBatch() takes in one syscall
+
+// frameSend: write one message, retrying short writes (waiting for room if
+// the socket is non-blocking) until all of it is sent. flags as for send().
+// Returns 0, or -1 with errno set.
+int frameSend(int sockfd, const char *msg, int flags);
+
+// frameSendBytes: frameSend() for a payload that isn't a string (binary messages)
+int frameSendBytes(int sockfd, const void *data, uint16_t len, int flags);
+
+// frameSendBatch: one sendmsg() of several already-framed buffers. Returns
+// the bytes written, which may stop part way through a frame, or -1.
+ssize_t frameSendBatch(int sockfd, const struct iovec *iov, int iovcnt, int flags);
+
+#endif
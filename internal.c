@@ -5,6 +5,7 @@
 #include <sys/mman.h> // For shm_open, mmap
 #include <unistd.h>   // For close
 #include "shared.h"
+#include "lockstat.h"
 
 // Internal control program for elevator car operation
 // Provides commands like:
@@ -58,6 +59,13 @@ int main(int argc, char *argv[])
     // printf("Internal is looking for memory named: [%s]\n", shm_name); // Debugging output
     sprintf(shm_name, "/car%s", car_name);
 
+    char lockstat_name[64];
+    snprintf(lockstat_name, sizeof(lockstat_name), "internal-%s", car_name);
+    if (lockstatInit(lockstat_name) != 0)
+    {
+        perror("lockstatInit");
+    }
+
     int fd = shm_open(shm_name, O_RDWR, 0666);
     if (fd == -1)
     {
@@ -75,53 +83,53 @@ int main(int argc, char *argv[])
 
     else if (strcmp(operation, "open") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->open_button = 1;
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
         printf("Signalled car %s to open doors.\n", car_name);
     }
 
     else if (strcmp(operation, "close") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->close_button = 1;
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else if (strcmp(operation, "stop") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->emergency_stop = 1;
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else if (strcmp(operation, "service_on") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->individual_service_mode = 1;
         shm_ptr->emergency_mode = 0;
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else if (strcmp(operation, "service_off") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         shm_ptr->individual_service_mode = 0;
         pthread_cond_broadcast(&shm_ptr->cond);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else if (strcmp(operation, "up") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         if (shm_ptr->individual_service_mode != 1)
         {
             printf("Operation only allowed in service mode.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -130,7 +138,7 @@ int main(int argc, char *argv[])
         if (strcmp(shm_ptr->status, "Closed") != 0)
         {
             printf("Operation not allowed while doors are open.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -139,7 +147,7 @@ int main(int argc, char *argv[])
         if (strcmp(shm_ptr->status, "Between") == 0)
         {
             printf("Operation not allowed while elevator is moving.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -156,16 +164,16 @@ int main(int argc, char *argv[])
         strcpy(shm_ptr->destination_floor, dest_floor_str);
         pthread_cond_broadcast(&shm_ptr->cond);
         printf("Signalled car %s to move up to floor %s.\n", car_name, dest_floor_str);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else if (strcmp(operation, "down") == 0)
     {
-        pthread_mutex_lock(&shm_ptr->mutex);
+        LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         if (shm_ptr->individual_service_mode != 1)
         {
             printf("Operation only allowed in service mode.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -174,7 +182,7 @@ int main(int argc, char *argv[])
         if (strcmp(shm_ptr->status, "Closed") != 0)
         {
             printf("Operation not allowed while doors are open.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -183,7 +191,7 @@ int main(int argc, char *argv[])
         if (strcmp(shm_ptr->status, "Between") == 0)
         {
             printf("Operation not allowed while elevator is moving.\n");
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             munmap(shm_ptr, sizeof(car_shared_mem));
             close(fd);
             return 1;
@@ -199,7 +207,7 @@ int main(int argc, char *argv[])
         strcpy(shm_ptr->destination_floor, dest_floor_str);
         pthread_cond_broadcast(&shm_ptr->cond);
         printf("Signalled car %s to move down to floor %s.\n", car_name, dest_floor_str);
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     else
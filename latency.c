@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "registry.h"
+#include "latency.h"
+#include "log.h"
+
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB (1 << LATENCY_SUB_BITS) // Buckets per power of two
+#define LATENCY_MAX_BITS 36                  // Values from 2^36us (about 19 hours) share the top buckets
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 2) * LATENCY_SUB)
+
+typedef struct
+{
+    unsigned int counts[LATENCY_BUCKETS];
+    unsigned long total;
+    unsigned long sum;
+    long max;
+} Histogram;
+
+struct LatencyHistograms
+{
+    Histogram kinds[LATENCY_KINDS];
+};
+
+static const char *kind_names[LATENCY_KINDS] = {"assign", "wait", "ride", "handle"};
+
+// monotonicUs: microseconds since some fixed point
+static long monotonicUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+long (*latency_clock)(void) = monotonicUs;
+
+static pthread_mutex_t latency_mutex = PTHREAD_MUTEX_INITIALIZER; // After any car lock
+static struct LatencyHistograms fleet;
+
+// bucketOf: values below LATENCY_SUB have a bucket each; above that, each power of two is split
+// into LATENCY_SUB buckets by the bits after the leading one
+static int bucketOf(long us)
+{
+    if (us < LATENCY_SUB)
+        return us < 0 ? 0 : (int)us;
+    int exponent = 63 - __builtin_clzl((unsigned long)us);
+    if (exponent > LATENCY_MAX_BITS)
+        return LATENCY_BUCKETS - 1;
+    int shift = exponent - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB + (int)((us >> shift) - LATENCY_SUB);
+}
+
+// bucketHighest: the largest value that lands in a bucket
+static long bucketHighest(int bucket)
+{
+    if (bucket < LATENCY_SUB)
+        return bucket;
+    int shift = bucket / LATENCY_SUB - 1;
+    long sub = bucket % LATENCY_SUB + LATENCY_SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void histogramAdd(Histogram *h, long us)
+{
+    if (us < 0)
+        us = 0;
+    h->counts[bucketOf(us)]++;
+    h->total++;
+    h->sum += us;
+    if (us > h->max)
+        h->max = us;
+}
+
+// histogramPercentile: the value at or below which pc percent of samples fall, to the top of
+// its bucket and never past the largest seen
+static long histogramPercentile(const Histogram *h, double pc)
+{
+    unsigned long rank = (unsigned long)(h->total * pc / 100.0 + 0.5);
+    if (rank < 1)
+        rank = 1;
+    unsigned long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += h->counts[b];
+        if (seen >= rank)
+        {
+            long highest = bucketHighest(b);
+            return highest < h->max ? highest : h->max;
+        }
+    }
+    return h->max;
+}
+
+void latencyRecord(Car *car, LatencyKind kind, long us)
+{
+    if (car != NULL)
+    {
+        if (car->latency == NULL)
+            car->latency = calloc(1, sizeof(struct LatencyHistograms));
+        histogramAdd(&car->latency->kinds[kind], us);
+    }
+    pthread_mutex_lock(&latency_mutex);
+    histogramAdd(&fleet.kinds[kind], us);
+    pthread_mutex_unlock(&latency_mutex);
+}
+
+void latencyRecordByName(const char *car_name, LatencyKind kind, long us)
+{
+    char first[50] = "";
+    if (car_name != NULL)
+        sscanf(car_name, "%49s", first);
+
+    registryReadLock();
+    Car *car = first[0] != '\0' ? findCarByName(first) : NULL;
+    if (car != NULL)
+        lockCar(car);
+    latencyRecord(car, kind, us);
+    if (car != NULL)
+        unlockCar(car);
+    registryUnlock();
+}
+
+void latencyReset(Car *car)
+{
+    if (car->latency != NULL)
+        memset(car->latency, 0, sizeof(struct LatencyHistograms));
+}
+
+// describeHistograms: the report for one set of histograms, after who
+static void describeHistograms(const char *who, const struct LatencyHistograms *set, char *buf, size_t size)
+{
+    size_t len = snprintf(buf, size, "LATENCY %s (ms)", who);
+    for (int k = 0; k < LATENCY_KINDS; k++)
+    {
+        const Histogram *h = &set->kinds[k];
+        double mean = h->total > 0 ? (double)h->sum / h->total : 0;
+        len += snprintf(buf + len, len < size ? size - len : 0,
+                        "%s %s n=%lu mean=%.3f p50=%.3f p90=%.3f p99=%.3f max=%.3f", k > 0 ? " |" : "",
+                        kind_names[k], h->total, mean / 1000, histogramPercentile(h, 50) / 1000.0,
+                        histogramPercentile(h, 90) / 1000.0, histogramPercentile(h, 99) / 1000.0,
+                        h->max / 1000.0);
+    }
+}
+
+void latencyDescribe(const char *car_name, char *buf, size_t size)
+{
+    // Copied out so the percentiles are worked out without holding anyone up
+    struct LatencyHistograms *copy = calloc(1, sizeof(struct LatencyHistograms));
+    if (car_name == NULL)
+    {
+        pthread_mutex_lock(&latency_mutex);
+        *copy = fleet;
+        pthread_mutex_unlock(&latency_mutex);
+        describeHistograms("fleet", copy, buf, size);
+        free(copy);
+        return;
+    }
+
+    registryReadLock();
+    Car *car = findCarByName(car_name);
+    if (car == NULL)
+    {
+        registryUnlock();
+        snprintf(buf, size, "ERROR Unknown car");
+        free(copy);
+        return;
+    }
+    lockCar(car);
+    if (car->latency != NULL)
+        *copy = *car->latency;
+    unlockCar(car);
+    registryUnlock();
+
+    describeHistograms(car_name, copy, buf, size);
+    free(copy);
+}
+
+static void *latencyDumpThread(void *arg)
+{
+    int seconds = *(int *)arg;
+    free(arg);
+    char line[1024];
+    while (1)
+    {
+        sleep(seconds);
+        latencyDescribe(NULL, line, sizeof(line) - 1);
+        strcat(line, "\n");
+        logLines(line);
+
+        // Names first, so no car is locked while printing
+        registryReadLock();
+        int count = num_cars;
+        char (*names)[50] = malloc((count > 0 ? count : 1) * sizeof(*names));
+        int num_names = 0;
+        for (int i = 0; i < count; i++)
+        {
+            Car *car = connected_cars[i];
+            lockCar(car);
+            if (car->latency != NULL)
+                strcpy(names[num_names++], car->name);
+            unlockCar(car);
+        }
+        registryUnlock();
+
+        for (int i = 0; i < num_names; i++)
+        {
+            latencyDescribe(names[i], line, sizeof(line) - 1);
+            strcat(line, "\n");
+            logLines(line);
+        }
+        free(names);
+    }
+    return NULL;
+}
+
+int latencyDumpStart(int seconds)
+{
+    int *arg = malloc(sizeof(int));
+    *arg = seconds;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, latencyDumpThread, arg) != 0)
+    {
+        free(arg);
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include "registry.h"
+
+// Latency histograms: how long calls take, fleet-wide and per car.
+//
+//   assign   a CALL arriving to its car being chosen (with --batch, this
+//            includes the wait for the window to close)
+//   wait     a CALL arriving to the car Opening at the source floor
+//   ride     that pickup to the car Opening at the destination
+//   handle   time spent handling a CALL, reply included
+//
+// Each histogram is HDR-style: LATENCY_SUB buckets for every power of two
+// of microseconds, so any value up to about 19 hours is kept to within 1/16
+// of itself, in a fixed 2KB. Recording is a couple of shifts and an add.
+// A car's histograms are allocated the first time it has something to
+// record, and cleared when a new car takes over its slot.
+//
+// The admin command LATENCY [car] reports percentiles on demand, and
+// --latency-dump <seconds> writes them to the log (log.h) periodically.
+
+typedef enum
+{
+    LATENCY_ASSIGN,
+    LATENCY_WAIT,
+    LATENCY_RIDE,
+    LATENCY_HANDLE,
+    LATENCY_KINDS
+} LatencyKind;
+
+// Microseconds on a monotonic clock; the fleet simulator swaps in its own step clock
+extern long (*latency_clock)(void);
+
+// latencyRecord: add a timing in microseconds to the fleet's histogram and, unless car is NULL,
+// the car's. Called with the car's lock held.
+void latencyRecord(Car *car, LatencyKind kind, long us);
+
+// latencyRecordByName: as latencyRecord(), for the car registered as car_name, which may also be
+// a trip's car list (see assignTrip()) to charge its first car. Fleet only if car_name is NULL or
+// not a car. Called without the registry lock held.
+void latencyRecordByName(const char *car_name, LatencyKind kind, long us);
+
+// latencyReset: clear a car's histograms, for a new car in its slot. Called with the registry
+// write-locked.
+void latencyReset(Car *car);
+
+// latencyDescribe: "LATENCY <who> (ms) assign n=... p50=... p90=... p99=... max=... | wait ..."
+// for the fleet (car_name NULL) or one car, or "ERROR Unknown car"
+void latencyDescribe(const char *car_name, char *buf, size_t size);
+
+// latencyDumpStart: print the fleet's and every car's latencies every few seconds.
+// Returns 0, or -1 if the thread could not start.
+int latencyDumpStart(int seconds);
+
+#endif
@@ -0,0 +1,115 @@
+// Lock report - prints the lock statistics of processes run with LOCKSTAT=1 (see lockstat.h)
+// Usage: ./lockreport [--clean]
+// Example: LOCKSTAT=1 ./controller --pool 8 &
+//          ./lockreport         - Per process, each lock site by total wait: acquisitions, how
+//                                 many waited, total/mean/max wait and total/mean/max hold
+//          ./lockreport --clean - The same, then remove the statistics of processes that have
+//                                 exited
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "lockstat.h"
+
+#define SHM_DIR "/dev/shm"
+
+// byWait: qsort order for sites, longest total wait first, then most acquisitions
+static int byWait(const void *a, const void *b)
+{
+    const LockSiteStats *x = a, *y = b;
+    if (x->wait_ns != y->wait_ns)
+        return x->wait_ns < y->wait_ns ? 1 : -1;
+    if (x->acquisitions != y->acquisitions)
+        return x->acquisitions < y->acquisitions ? 1 : -1;
+    return 0;
+}
+
+// printRegion: one process's sites
+static void printRegion(const LockStatRegion *region, int running)
+{
+    int num_sites = region->num_sites < LOCKSTAT_MAX_SITES ? region->num_sites : LOCKSTAT_MAX_SITES;
+    printf("%s (pid %d%s)\n", region->program, region->pid, running ? "" : ", exited");
+    if (num_sites == 0)
+    {
+        printf("  no locks taken\n\n");
+        return;
+    }
+
+    LockSiteStats *sites = malloc(num_sites * sizeof(LockSiteStats));
+    memcpy(sites, region->sites, num_sites * sizeof(LockSiteStats));
+    qsort(sites, num_sites, sizeof(LockSiteStats), byWait);
+
+    printf("  %-22s %-30s %10s %8s %10s %9s %9s %10s %9s %9s\n", "lock", "site", "acquired", "waited",
+           "wait_ms", "mean_us", "max_us", "hold_ms", "mean_us", "max_us");
+    for (int i = 0; i < num_sites; i++)
+    {
+        const LockSiteStats *s = &sites[i];
+        printf("  %-22s %-30s %10lu %7.1f%% %10.3f %9.2f %9.2f %10.3f %9.2f %9.2f\n", s->lock, s->where,
+               s->acquisitions, s->acquisitions > 0 ? 100.0 * s->contended / s->acquisitions : 0.0,
+               s->wait_ns / 1e6, s->contended > 0 ? s->wait_ns / 1e3 / s->contended : 0.0, s->max_wait_ns / 1e3,
+               s->hold_ns / 1e6, s->acquisitions > 0 ? s->hold_ns / 1e3 / s->acquisitions : 0.0,
+               s->max_hold_ns / 1e3);
+    }
+    printf("\n");
+    free(sites);
+}
+
+// main: find every process's statistics in shared memory and print them
+int main(int argc, char *argv[])
+{
+    int clean = argc == 2 && strcmp(argv[1], "--clean") == 0;
+    if (argc > 2 || (argc == 2 && !clean))
+    {
+        fprintf(stderr, "Usage: %s [--clean]\n", argv[0]);
+        return 1;
+    }
+
+    DIR *dir = opendir(SHM_DIR);
+    if (dir == NULL)
+    {
+        perror(SHM_DIR);
+        return 1;
+    }
+
+    const char *prefix = LOCKSTAT_SHM_PREFIX + 1; // Without the '/'
+    int found = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, prefix, strlen(prefix)) != 0)
+            continue;
+
+        char name[300];
+        snprintf(name, sizeof(name), "/%s", entry->d_name);
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd == -1)
+            continue;
+        LockStatRegion *region = mmap(NULL, sizeof(LockStatRegion), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (region == MAP_FAILED)
+            continue;
+
+        int running = kill(region->pid, 0) == 0 || errno == EPERM;
+        printRegion(region, running);
+        munmap(region, sizeof(LockStatRegion));
+        found++;
+
+        if (clean && !running)
+        {
+            shm_unlink(name);
+        }
+    }
+    closedir(dir);
+
+    if (found == 0)
+    {
+        printf("No lock statistics. Run a program with LOCKSTAT=1 to record them.\n");
+    }
+    return 0;
+}
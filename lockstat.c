@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "lockstat.h"
+
+LockStatRegion *lockstat_region = NULL;
+__thread LockHold lockstat_hold;
+
+static pthread_mutex_t sites_mutex = PTHREAD_MUTEX_INITIALIZER; // Only to add a site
+
+int lockstatInit(const char *program)
+{
+    const char *setting = getenv("LOCKSTAT");
+    if (setting == NULL || strcmp(setting, "0") == 0)
+        return 0;
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s%s-%d", LOCKSTAT_SHM_PREFIX, program, (int)getpid());
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0666);
+    if (fd == -1)
+        return -1;
+    if (ftruncate(fd, sizeof(LockStatRegion)) == -1)
+    {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    LockStatRegion *region = mmap(NULL, sizeof(LockStatRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return -1;
+    }
+
+    snprintf(region->program, sizeof(region->program), "%s", program);
+    region->pid = (int)getpid();
+    lockstat_region = region;
+    return 0;
+}
+
+long lockstatNow(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// siteStats: the counts for a site, given a slot the first time it is taken
+static LockSiteStats *siteStats(LockSite *site)
+{
+    int index = __atomic_load_n(&site->index, __ATOMIC_ACQUIRE);
+    if (index >= 0)
+        return &lockstat_region->sites[index];
+
+    pthread_mutex_lock(&sites_mutex);
+    index = site->index;
+    if (index < 0)
+    {
+        LockSiteStats *stats;
+        if (lockstat_region->num_sites < LOCKSTAT_MAX_SITES)
+        {
+            index = lockstat_region->num_sites;
+            stats = &lockstat_region->sites[index];
+            snprintf(stats->lock, sizeof(stats->lock), "%s", site->lock);
+            snprintf(stats->where, sizeof(stats->where), "%s:%d", site->function, site->line);
+            __atomic_store_n(&lockstat_region->num_sites, index + 1, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            index = LOCKSTAT_MAX_SITES - 1;
+            stats = &lockstat_region->sites[index];
+            snprintf(stats->where, sizeof(stats->where), "(other)");
+        }
+        __atomic_store_n(&site->index, index, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&sites_mutex);
+    return &lockstat_region->sites[index];
+}
+
+// raiseMax: *max = value if that is larger, racing other threads safely
+static void raiseMax(unsigned long *max, unsigned long value)
+{
+    unsigned long seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > seen && !__atomic_compare_exchange_n(max, &seen, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+void lockstatAcquired(LockSite *site, LockHold *hold, long wait_ns, int contended)
+{
+    LockSiteStats *stats = siteStats(site);
+    __atomic_fetch_add(&stats->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended)
+    {
+        __atomic_fetch_add(&stats->contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->wait_ns, wait_ns, __ATOMIC_RELAXED);
+        raiseMax(&stats->max_wait_ns, wait_ns);
+    }
+    hold->stats = stats;
+    hold->since_ns = lockstatNow();
+}
+
+void lockstatReleased(LockHold *hold)
+{
+    if (hold->stats == NULL)
+        return; // Taken before statistics were switched on
+    long held = lockstatNow() - hold->since_ns;
+    __atomic_fetch_add(&hold->stats->hold_ns, held, __ATOMIC_RELAXED);
+    raiseMax(&hold->stats->max_hold_ns, held);
+}
@@ -0,0 +1,141 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include <pthread.h>
+#include <time.h>
+
+// Lock contention statistics, switched on by LOCKSTAT=1 in a program's environment.
+//
+// Every place in the code that takes an instrumented lock (a site) counts its acquisitions,
+// how many had to wait (the trylock failed), the total and longest wait and the total and
+// longest hold. Time spent in a condition wait is not counted as holding the lock, and
+// getting it back afterwards is not a new acquisition.
+//
+// Each process keeps its counts in a shared memory object, LOCKSTAT_SHM_PREFIX followed by
+// "<program>-<pid>", so ./lockreport can read them while the process runs or after it has
+// been killed. Switched off, taking a lock costs one extra test of lockstat_region.
+//
+// The counts are updated with atomic adds, so sites taken by several threads at once (the
+// registry's read lock) stay exact; the maxima are updated the same way.
+
+#define LOCKSTAT_MAX_SITES 128 // Sites past this are all counted as the last one, "(other)"
+#define LOCKSTAT_SHM_PREFIX "/lockstat-"
+#define LOCKSTAT_SHM_MUTEX "car_shared_mem.mutex" // Name for the car's shared memory mutex
+
+typedef struct
+{
+    char lock[32];  // Which lock, e.g. "car_shared_mem.mutex"
+    char where[48]; // "function:line" of the site
+    unsigned long acquisitions;
+    unsigned long contended; // Acquisitions that had to wait
+    unsigned long wait_ns;
+    unsigned long max_wait_ns;
+    unsigned long hold_ns;
+    unsigned long max_hold_ns;
+} LockSiteStats;
+
+typedef struct
+{
+    char program[48];
+    int pid;
+    int num_sites;
+    LockSiteStats sites[LOCKSTAT_MAX_SITES];
+} LockStatRegion;
+
+// A site, as a static at the place the lock is taken; see LOCKSTAT_SITE()
+typedef struct
+{
+    const char *lock;
+    const char *function;
+    int line;
+    int index; // Into the region's sites, -1 until first taken
+} LockSite;
+
+#define LOCKSTAT_SITE(lock) {lock, __func__, __LINE__, -1}
+
+// LOCKSTAT_HERE: a pointer to a new site right here, for wrappers like registryReadLock()
+#define LOCKSTAT_HERE(lock)                                   \
+    ({                                                        \
+        static LockSite lockstat_site_ = LOCKSTAT_SITE(lock); \
+        &lockstat_site_;                                      \
+    })
+
+// What one thread holds of one lock: the site that took it and since when
+typedef struct
+{
+    LockSiteStats *stats;
+    long since_ns;
+} LockHold;
+
+extern LockStatRegion *lockstat_region; // NULL while switched off
+
+// This thread's hold, for programs that hold one instrumented lock at a time (car, safety,
+// internal); the controller keeps one per lock in registry.c
+extern __thread LockHold lockstat_hold;
+
+// lockstatInit: if LOCKSTAT is set (and not "0"), create this process's region. Returns 0,
+// or -1 if it is set but the region could not be created (statistics stay off).
+int lockstatInit(const char *program);
+
+long lockstatNow(void); // Monotonic nanoseconds
+
+// lockstatAcquired: a site has just taken its lock after waiting wait_ns (0 and not
+// contended if the trylock worked); the hold starts now
+void lockstatAcquired(LockSite *site, LockHold *hold, long wait_ns, int contended);
+
+// lockstatReleased: the lock is about to be released (or given up for a condition wait)
+void lockstatReleased(LockHold *hold);
+
+// lockstatMutexLock: pthread_mutex_lock() for a site, use LOCKSTAT_LOCK()
+static inline int lockstatMutexLock(pthread_mutex_t *mutex, LockSite *site, LockHold *hold)
+{
+    if (lockstat_region == NULL)
+        return pthread_mutex_lock(mutex);
+    if (pthread_mutex_trylock(mutex) == 0)
+    {
+        lockstatAcquired(site, hold, 0, 0);
+        return 0;
+    }
+    long start = lockstatNow();
+    int result = pthread_mutex_lock(mutex);
+    if (result == 0)
+        lockstatAcquired(site, hold, lockstatNow() - start, 1);
+    return result;
+}
+
+// LOCKSTAT_LOCK: lock a mutex as a site of lock, as this thread's lockstat_hold.
+// Returns pthread_mutex_lock()'s result.
+#define LOCKSTAT_LOCK(mutex, lock) lockstatMutexLock((mutex), LOCKSTAT_HERE(lock), &lockstat_hold)
+
+// lockstatUnlock: pthread_mutex_unlock() of a mutex taken by LOCKSTAT_LOCK()
+static inline int lockstatUnlock(pthread_mutex_t *mutex)
+{
+    if (lockstat_region != NULL)
+        lockstatReleased(&lockstat_hold);
+    return pthread_mutex_unlock(mutex);
+}
+
+// lockstatCondWait: pthread_cond_wait() on a mutex taken by LOCKSTAT_LOCK()
+static inline int lockstatCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    if (lockstat_region == NULL)
+        return pthread_cond_wait(cond, mutex);
+    lockstatReleased(&lockstat_hold);
+    int result = pthread_cond_wait(cond, mutex);
+    lockstat_hold.since_ns = lockstatNow();
+    return result;
+}
+
+// lockstatCondTimedwait: pthread_cond_timedwait() on a mutex taken by LOCKSTAT_LOCK()
+static inline int lockstatCondTimedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                                        const struct timespec *abstime)
+{
+    if (lockstat_region == NULL)
+        return pthread_cond_timedwait(cond, mutex, abstime);
+    lockstatReleased(&lockstat_hold);
+    int result = pthread_cond_timedwait(cond, mutex, abstime);
+    lockstat_hold.since_ns = lockstatNow();
+    return result;
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "log.h"
+
+#define LOG_RING_SIZE 256 // Records per thread, a power of two
+#define LOG_DRAIN_MS 5
+
+typedef union
+{
+    int i;
+    unsigned int u;
+    long l;
+    unsigned long ul;
+    double d;
+    unsigned short text; // Offset of a string in the record's text
+} LogArg;
+
+typedef struct
+{
+    long time_ns;
+    const char *format;
+    int level;
+    char types[LOG_MAX_ARGS + 1];
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+} LogRecord;
+
+// One thread's records. head is written only by that thread, tail only by the drain thread.
+typedef struct LogRing
+{
+    LogRecord records[LOG_RING_SIZE];
+    _Alignas(64) unsigned long head; // Next to write
+    _Alignas(64) unsigned long tail; // Next to read
+    unsigned long dropped;           // Records lost to a full ring, since the last drain
+    int retired;                     // Its thread has exited; freed once drained
+    struct LogRing *next;
+} LogRing;
+
+int log_level = LOG_LEVEL_OFF;
+
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER; // The list, not the records
+static LogRing *rings = NULL;
+static pthread_key_t ring_key;
+static __thread LogRing *thread_ring = NULL;
+
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER; // One reader at a time
+static FILE *log_out = NULL; // stderr, or LOG_FILE; never stdout
+static LogRecord *batch = NULL;
+static int batch_capacity = 0;
+
+static long nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// retireRing: a thread with a ring has exited
+static void retireRing(void *ring)
+{
+    __atomic_store_n(&((LogRing *)ring)->retired, 1, __ATOMIC_RELEASE);
+}
+
+// ringForThread: this thread's ring, added to the list the first time it logs
+static LogRing *ringForThread(void)
+{
+    if (thread_ring != NULL)
+        return thread_ring;
+
+    LogRing *ring = calloc(1, sizeof(LogRing));
+    if (ring == NULL)
+        return NULL;
+    pthread_mutex_lock(&rings_mutex);
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&rings_mutex);
+    pthread_setspecific(ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+void logWrite(int level, const char *format, const char *types, ...)
+{
+    LogRing *ring = ringForThread();
+    if (ring == NULL)
+        return;
+
+    unsigned long head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == LOG_RING_SIZE)
+    {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    LogRecord *record = &ring->records[head % LOG_RING_SIZE];
+    record->time_ns = nowNs();
+    record->format = format;
+    record->level = level;
+
+    va_list ap;
+    va_start(ap, types);
+    size_t used = 0;
+    int n;
+    for (n = 0; types[n] != '\0' && n < LOG_MAX_ARGS; n++)
+    {
+        LogArg *arg = &record->args[n];
+        switch (types[n])
+        {
+        case 's':
+        {
+            const char *s = va_arg(ap, const char *);
+            size_t len = s != NULL ? strlen(s) : 0;
+            if (used + len >= LOG_TEXT_SIZE)
+                len = used < LOG_TEXT_SIZE ? LOG_TEXT_SIZE - 1 - used : 0; // Cut short
+            arg->text = used < LOG_TEXT_SIZE ? used : LOG_TEXT_SIZE - 1;
+            memcpy(record->text + arg->text, s, len);
+            record->text[arg->text + len] = '\0';
+            used += len + 1;
+            break;
+        }
+        case 'u':
+            arg->u = va_arg(ap, unsigned int);
+            break;
+        case 'l':
+            arg->l = va_arg(ap, long);
+            break;
+        case 'L':
+            arg->ul = va_arg(ap, unsigned long);
+            break;
+        case 'd':
+            arg->d = va_arg(ap, double);
+            break;
+        default:
+            arg->i = va_arg(ap, int);
+            break;
+        }
+        record->types[n] = types[n];
+    }
+    record->types[n] = '\0';
+    va_end(ap);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// formatRecord: printf() the record's format with its arguments into buf, one conversion at a time
+static void formatRecord(const LogRecord *record, char *buf, size_t size)
+{
+    size_t len = 0;
+    int n = 0;
+    for (const char *f = record->format; *f != '\0' && len + 1 < size;)
+    {
+        if (*f != '%')
+        {
+            buf[len++] = *f++;
+            continue;
+        }
+        if (f[1] == '%')
+        {
+            buf[len++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // The whole conversion, e.g. "%-10.3f" or "%lu"
+        char spec[32];
+        size_t spec_len = 0;
+        do
+        {
+            if (spec_len < sizeof(spec) - 1)
+                spec[spec_len++] = *f;
+            f++;
+        } while (*f != '\0' && strchr("diouxXeEfgGcs", *f) == NULL);
+        if (*f == '\0' || record->types[n] == '\0')
+            break; // Malformed, or more conversions than arguments
+        spec[spec_len++] = *f++;
+        spec[spec_len] = '\0';
+
+        const LogArg *arg = &record->args[n];
+        size_t room = size - len;
+        int wrote;
+        switch (record->types[n++])
+        {
+        case 's':
+            wrote = snprintf(buf + len, room, spec, record->text + arg->text);
+            break;
+        case 'u':
+            wrote = snprintf(buf + len, room, spec, arg->u);
+            break;
+        case 'l':
+            wrote = snprintf(buf + len, room, spec, arg->l);
+            break;
+        case 'L':
+            wrote = snprintf(buf + len, room, spec, arg->ul);
+            break;
+        case 'd':
+            wrote = snprintf(buf + len, room, spec, arg->d);
+            break;
+        default:
+            wrote = snprintf(buf + len, room, spec, arg->i);
+            break;
+        }
+        if (wrote > 0)
+            len += (size_t)wrote < room ? (size_t)wrote : room - 1;
+    }
+    buf[len] = '\0';
+}
+
+// byTime: qsort order for records, oldest first
+static int byTime(const void *a, const void *b)
+{
+    const LogRecord *x = a, *y = b;
+    return x->time_ns < y->time_ns ? -1 : x->time_ns > y->time_ns;
+}
+
+// drain: take every ring's records, then print them in time order. Called with drain_mutex held.
+// Returns how many there were.
+static int drain(void)
+{
+    int count = 0;
+    unsigned long dropped = 0;
+
+    pthread_mutex_lock(&rings_mutex);
+    LogRing **link = &rings;
+    while (*link != NULL)
+    {
+        LogRing *ring = *link;
+        int retired = __atomic_load_n(&ring->retired, __ATOMIC_ACQUIRE);
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long tail = ring->tail;
+        if (batch_capacity < count + (int)(head - tail))
+        {
+            batch_capacity = count + (int)(head - tail) + LOG_RING_SIZE;
+            batch = realloc(batch, batch_capacity * sizeof(LogRecord));
+        }
+        for (; tail != head; tail++)
+        {
+            batch[count++] = ring->records[tail % LOG_RING_SIZE];
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        dropped += __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+
+        if (retired)
+        {
+            *link = ring->next; // Its thread has gone, and every record it made has been taken
+            free(ring);
+        }
+        else
+        {
+            link = &ring->next;
+        }
+    }
+    pthread_mutex_unlock(&rings_mutex);
+
+    qsort(batch, count, sizeof(LogRecord), byTime);
+    char line[1024];
+    for (int i = 0; i < count; i++)
+    {
+        formatRecord(&batch[i], line, sizeof(line));
+        fputs(line, log_out);
+    }
+    if (dropped > 0)
+    {
+        fprintf(log_out, "(%lu log records dropped)\n", dropped);
+    }
+    if (count > 0 || dropped > 0)
+    {
+        fflush(log_out);
+    }
+    return count;
+}
+
+void logFlush(void)
+{
+    pthread_mutex_lock(&drain_mutex);
+    drain();
+    pthread_mutex_unlock(&drain_mutex);
+}
+
+void logLines(const char *text)
+{
+    pthread_mutex_lock(&drain_mutex);
+    drain();
+    FILE *out = log_out != NULL ? log_out : stderr;
+    fputs(text, out);
+    fflush(out);
+    pthread_mutex_unlock(&drain_mutex);
+}
+
+// flushAtExit: logFlush(), unless exit() was called by a signal handler that interrupted a drain
+static void flushAtExit(void)
+{
+    if (pthread_mutex_trylock(&drain_mutex) == 0)
+    {
+        drain();
+        pthread_mutex_unlock(&drain_mutex);
+    }
+}
+
+// drainThread: drain every LOG_DRAIN_MS, or straight away again while there are records coming in
+static void *drainThread(void *arg)
+{
+    (void)arg;
+    struct timespec interval = {0, LOG_DRAIN_MS * 1000000L};
+    while (1)
+    {
+        pthread_mutex_lock(&drain_mutex);
+        int count = drain();
+        pthread_mutex_unlock(&drain_mutex);
+        if (count == 0)
+            nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+// levelFromName: a LOG_LEVEL setting, or -1 if it isn't one
+static int levelFromName(const char *name)
+{
+    const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_OFF; level++)
+    {
+        if (strcmp(name, names[level]) == 0)
+            return level;
+    }
+    return -1;
+}
+
+int logStart(void)
+{
+    int level = LOG_LEVEL_DEBUG;
+    const char *setting = getenv("LOG_LEVEL");
+    if (setting != NULL)
+    {
+        level = levelFromName(setting);
+        if (level == -1)
+        {
+            fprintf(stderr, "Unknown LOG_LEVEL %s, logging everything\n", setting);
+            level = LOG_LEVEL_DEBUG;
+        }
+    }
+
+    // A stream of its own, fully buffered and written once per drain, so a batch costs one write()
+    const char *path = getenv("LOG_FILE");
+    if (path != NULL)
+    {
+        log_out = fopen(path, "a");
+        if (log_out == NULL)
+            perror(path);
+    }
+    if (log_out == NULL)
+    {
+        int fd = dup(STDERR_FILENO);
+        log_out = fd != -1 ? fdopen(fd, "w") : NULL;
+        if (log_out == NULL)
+        {
+            if (fd != -1)
+                close(fd);
+            log_out = stderr;
+        }
+    }
+    setvbuf(log_out, NULL, _IOFBF, BUFSIZ);
+
+    pthread_key_create(&ring_key, retireRing);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, drainThread, NULL) != 0)
+    {
+        return -1;
+    }
+    pthread_detach(thread);
+    atexit(flushAtExit);
+    log_level = level;
+    return 0;
+}
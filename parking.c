@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "parking.h"
+#include "log.h"
+
+#define PARK_SLOT_MINUTES 15
+#define PARK_SLOTS (24 * 60 / PARK_SLOT_MINUTES)
+#define PARK_DAY_MS (24L * 60 * 60 * 1000)
+#define PARK_DECAY 0.5f      // Share of a slot's old counts kept on a new day
+#define PARK_MIN_SAVING 1.0  // Floors of expected distance a move has to save
+
+// localMs: milliseconds since the epoch, shifted to local time so days start at midnight
+static long localMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    struct tm local;
+    localtime_r(&now.tv_sec, &local);
+    return (now.tv_sec + local.tm_gmtoff) * 1000L + now.tv_nsec / 1000000L;
+}
+
+int parking_enabled = 0;
+long (*parking_clock)(void) = localMs;
+
+static pthread_mutex_t parking_mutex = PTHREAD_MUTEX_INITIALIZER;
+static float demand[PARK_SLOTS][STOP_FLOORS]; // Call origins by slot and floor, less STOP_MIN_FLOOR
+static long slot_day[PARK_SLOTS];              // Day each slot was last counted on
+
+void parkingInit(void)
+{
+    pthread_mutex_lock(&parking_mutex);
+    memset(demand, 0, sizeof(demand));
+    memset(slot_day, 0, sizeof(slot_day));
+    pthread_mutex_unlock(&parking_mutex);
+}
+
+void parkingRecordCall(int source)
+{
+    if (source < STOP_MIN_FLOOR || source > STOP_MAX_FLOOR)
+        return;
+
+    long now = parking_clock();
+    long day = now / PARK_DAY_MS + 1; // Never 0, which marks a slot never counted
+    int slot = (now % PARK_DAY_MS) / (PARK_SLOT_MINUTES * 60000L);
+
+    pthread_mutex_lock(&parking_mutex);
+    if (slot_day[slot] != day)
+    {
+        for (int f = 0; f < STOP_FLOORS; f++)
+            demand[slot][f] *= PARK_DECAY;
+        slot_day[slot] = day;
+    }
+    demand[slot][source - STOP_MIN_FLOOR] += 1;
+    pthread_mutex_unlock(&parking_mutex);
+}
+
+// addSlope: add v to the slope of every step p -> p + 1 from a to b, kept as a difference array
+static void addSlope(double *slope, int span, int a, int b, double v)
+{
+    if (a < 0)
+        a = 0;
+    if (b > span - 2)
+        b = span - 2;
+    if (a > b)
+        return;
+    slope[a] += v;
+    slope[b + 1] -= v;
+}
+
+// expectedDistances: average floors from a call to the nearest idle car if this car waits at
+// floor lowest + p, for every p, into distance[p]. nearest[i] is how far floor lowest + i is
+// from the nearest other idle car. A call i floors up only gets nearer as the car comes up to
+// it from within nearest[i] floors, and further as it moves away, so each floor's share is
+// a slope over a few ranges of p and one pass over the span adds them all up.
+static void expectedDistances(const float *want, const int *nearest, int span, double total, double *distance)
+{
+    double *slope = calloc(span, sizeof(double));
+    double sum = 0; // With the car at the bottom floor
+    for (int i = 0; i < span; i++)
+    {
+        if (want[i] == 0)
+            continue;
+        int n = nearest[i];
+        sum += want[i] * (i < n ? i : n);
+        addSlope(slope, span, i - n, i - 1, -want[i]);
+        addSlope(slope, span, i, i + n - 1, want[i]);
+    }
+
+    double step = 0;
+    for (int p = 0; p < span; p++)
+    {
+        distance[p] = sum / total;
+        step += slope[p];
+        sum += step;
+    }
+    free(slope);
+}
+
+void parkingCarIdle(Car *idle)
+{
+    lockCar(idle);
+    int at = idle->current_floor;
+    int lowest = idle->lowest_floor, highest = idle->highest_floor;
+    int settled = idle->status == CAR_CLOSED && idle->destination_floor == at && stopSetCount(&idle->stops) == 0;
+    if (!settled || idle->park_checked)
+    {
+        unlockCar(idle);
+        return;
+    }
+    idle->park_checked = 1;
+    unlockCar(idle);
+
+    // Where the other idle cars wait (or are going to); busy ones will be somewhere else soon
+    int active = 0, busy = 0, num_others = 0;
+    int *others = malloc(num_cars * sizeof(int));
+    for (int i = 0; i < num_cars; i++)
+    {
+        Car *car = connected_cars[i];
+        if (!car->is_active)
+            continue;
+        active++;
+        if (car == idle)
+            continue;
+        lockCar(car);
+        if (stopSetCount(&car->stops) > 0)
+            busy++;
+        else
+            others[num_others++] = car->destination_floor;
+        unlockCar(car);
+    }
+    if (busy * 2 >= active)
+    {
+        free(others);
+        return; // A peak: no empty trips
+    }
+
+    // Demand this slot and the next, over the floors this car serves
+    int span = highest - lowest + 1;
+    float *want = calloc(span, sizeof(float));
+    double total = 0;
+    long now = parking_clock();
+    int slot = (now % PARK_DAY_MS) / (PARK_SLOT_MINUTES * 60000L);
+    int next = (slot + 1) % PARK_SLOTS;
+    pthread_mutex_lock(&parking_mutex);
+    for (int i = 0; i < span; i++)
+    {
+        want[i] = demand[slot][lowest + i - STOP_MIN_FLOOR] + demand[next][lowest + i - STOP_MIN_FLOOR];
+        total += want[i];
+    }
+    pthread_mutex_unlock(&parking_mutex);
+
+    if (total > 0)
+    {
+        // Distance to the nearest other idle car: where they are, then spread out a floor at a
+        // time both ways
+        int *nearest = malloc(span * sizeof(int));
+        for (int i = 0; i < span; i++)
+            nearest[i] = STOP_FLOORS;
+        for (int k = 0; k < num_others; k++)
+        {
+            if (others[k] < lowest)
+            {
+                if (lowest - others[k] < nearest[0])
+                    nearest[0] = lowest - others[k];
+            }
+            else if (others[k] > highest)
+            {
+                if (others[k] - highest < nearest[span - 1])
+                    nearest[span - 1] = others[k] - highest;
+            }
+            else
+            {
+                nearest[others[k] - lowest] = 0;
+            }
+        }
+        for (int i = 1; i < span; i++)
+        {
+            if (nearest[i - 1] + 1 < nearest[i])
+                nearest[i] = nearest[i - 1] + 1;
+        }
+        for (int i = span - 2; i >= 0; i--)
+        {
+            if (nearest[i + 1] + 1 < nearest[i])
+                nearest[i] = nearest[i + 1] + 1;
+        }
+
+        double *distance = malloc(span * sizeof(double));
+        expectedDistances(want, nearest, span, total, distance);
+        int best = at;
+        double staying = distance[at - lowest];
+        double best_distance = staying;
+        for (int floor = lowest; floor <= highest; floor++)
+        {
+            if (distance[floor - lowest] < best_distance)
+            {
+                best = floor;
+                best_distance = distance[floor - lowest];
+            }
+        }
+        free(distance);
+
+        if (best != at && staying - best_distance >= PARK_MIN_SAVING)
+        {
+            lockCar(idle);
+            // Only if nothing has come up for it in the meantime
+            if (stopSetCount(&idle->stops) == 0 && idle->status == CAR_CLOSED && idle->current_floor == at)
+            {
+                char floor_str[8];
+                int_to_floor(best, floor_str);
+                sendFloorToCar(idle, best);
+                idle->destination_floor = best;
+                logInfo("Parking car %s at floor %s\n", idle->name, floor_str);
+            }
+            unlockCar(idle);
+        }
+        free(nearest);
+    }
+
+    free(want);
+    free(others);
+}
@@ -0,0 +1,42 @@
+#ifndef PARKING_H
+#define PARKING_H
+
+#include "registry.h"
+
+// Idle car parking (--park): send a car that has run out of stops to wait
+// where the next call is likely to come from, instead of wherever it last
+// stopped.
+//
+// Call origins are counted in a histogram per PARK_SLOT_MINUTES slot of the
+// day. The first call in a slot on a new day halves what that slot held, so
+// the histogram follows the building's weekly habits without forgetting them
+// after one odd day. When a car goes idle, demand for this slot and the next
+// is weighed against where the other idle cars are already waiting, and the
+// car parks at the floor in its range that brings the expected distance from
+// a call to the nearest idle car down the most - so parked cars spread out
+// rather than sitting together. It parks with an ordinary FLOOR message.
+//
+// A car is only parked if that saves at least PARK_MIN_SAVING floors on
+// average, at most once per idle spell, and never while half or more of the
+// fleet is busy: in a peak there are calls enough to keep cars moving
+// without empty trips.
+
+extern int parking_enabled; // Set by --park
+
+// Local time in milliseconds (only the time of day and the day number are used);
+// the fleet simulator swaps in its own step clock
+extern long (*parking_clock)(void);
+
+// parkingInit: forget all demand
+void parkingInit(void);
+
+// parkingRecordCall: count a call's origin at the current time of day.
+// Called without the registry lock held.
+void parkingRecordCall(int source);
+
+// parkingCarIdle: consider parking a car that has just closed its doors with no stops left.
+// Called with the registry lock held, but not the car's lock. Costs one pass over the car's floors
+// and one over the fleet, since it runs on the STATUS path.
+void parkingCarIdle(Car *car);
+
+#endif
@@ -0,0 +1,70 @@
+#include <string.h>
+#include <arpa/inet.h>
+#include "protocol.h"
+
+static const char *status_names[] = {"Opening", "Open", "Closing", "Closed", "Between"};
+
+const char *carStatusName(CarStatus status)
+{
+    if (status < 0 || status >= CAR_STATUS_UNKNOWN)
+    {
+        return "Unknown";
+    }
+    return status_names[status];
+}
+
+CarStatus carStatusFromName(const char *name)
+{
+    for (int i = 0; i < CAR_STATUS_UNKNOWN; i++)
+    {
+        if (strcmp(name, status_names[i]) == 0)
+        {
+            return (CarStatus)i;
+        }
+    }
+    return CAR_STATUS_UNKNOWN;
+}
+
+static void putInt16(uint8_t *buf, int value)
+{
+    uint16_t net = htons((uint16_t)(int16_t)value);
+    memcpy(buf, &net, sizeof(net));
+}
+
+static int getInt16(const uint8_t *buf)
+{
+    uint16_t net;
+    memcpy(&net, buf, sizeof(net));
+    return (int16_t)ntohs(net);
+}
+
+size_t encodeV2(uint8_t *buf, const V2Message *msg)
+{
+    buf[0] = msg->type;
+    buf[1] = msg->type == V2_STATUS ? (uint8_t)msg->status : 0;
+    uint16_t seq = htons(msg->seq);
+    memcpy(buf + 2, &seq, sizeof(seq));
+    putInt16(buf + 4, msg->floor);
+    putInt16(buf + 6, msg->type == V2_STATUS ? msg->destination : 0);
+    return V2_MESSAGE_SIZE;
+}
+
+int decodeV2(const uint8_t *buf, size_t len, V2Message *msg)
+{
+    if (len != V2_MESSAGE_SIZE || buf[0] < V2_STATUS || buf[0] > V2_EMERGENCY)
+    {
+        return -1;
+    }
+    msg->type = buf[0];
+    msg->status = (CarStatus)buf[1];
+    if (msg->type == V2_STATUS && msg->status >= CAR_STATUS_UNKNOWN)
+    {
+        return -1;
+    }
+    uint16_t seq;
+    memcpy(&seq, buf + 2, sizeof(seq));
+    msg->seq = ntohs(seq);
+    msg->floor = getInt16(buf + 4);
+    msg->destination = getInt16(buf + 6);
+    return 0;
+}
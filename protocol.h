@@ -0,0 +1,66 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Car <-> controller message encodings, carried in the usual length-prefixed
+// frames (see frame.h).
+//
+// Version 1 is text: "STATUS Closed 3 5", "FLOOR B2" and so on, with floors
+// as strings. A car that can do better appends BINARY to its registration
+// ("CAR Alpha 1 5 BINARY"); a controller that understands answers with the
+// text frame "PROTOCOL 2" and every later frame in both directions is then a
+// version 2 binary message. A controller that doesn't understand never says
+// PROTOCOL 2, so both sides stay on text.
+//
+// Version 2 messages, all integers in network byte order:
+//   byte 0     message type (V2_STATUS, V2_FLOOR, ...)
+//   byte 1     CarStatus (V2_STATUS only, 0 otherwise)
+//   bytes 2-3  sequence number, counting up per sender from 0
+//   bytes 4-5  signed 16-bit floor: current floor (STATUS) or target (FLOOR)
+//   bytes 6-7  signed 16-bit destination floor (STATUS only)
+// Floors use the same numbering as floor_to_int(): B1 is -1.
+
+#define PROTOCOL_TEXT 1
+#define PROTOCOL_BINARY 2
+#define PROTOCOL_OFFER "BINARY"      // Last word of a CAR message offering version 2
+#define PROTOCOL_ACCEPT "PROTOCOL 2" // Controller's reply taking the offer
+
+typedef enum
+{
+    CAR_OPENING,
+    CAR_OPEN,
+    CAR_CLOSING,
+    CAR_CLOSED,
+    CAR_BETWEEN,
+    CAR_STATUS_UNKNOWN
+} CarStatus;
+
+// Version 2 message types
+#define V2_STATUS 1
+#define V2_FLOOR 2
+#define V2_INDIVIDUAL_SERVICE 3
+#define V2_EMERGENCY 4
+
+#define V2_MESSAGE_SIZE 8 // Every version 2 message is this long
+
+typedef struct
+{
+    uint8_t type;
+    CarStatus status;
+    uint16_t seq;
+    int floor;       // Current floor (STATUS) or target floor (FLOOR)
+    int destination; // STATUS only
+} V2Message;
+
+const char *carStatusName(CarStatus status);
+CarStatus carStatusFromName(const char *name); // CAR_STATUS_UNKNOWN if not a status
+
+// encodeV2: fill buf (V2_MESSAGE_SIZE bytes) and return its length
+size_t encodeV2(uint8_t *buf, const V2Message *msg);
+
+// decodeV2: 0 on success, -1 if buf isn't a well-formed version 2 message
+int decodeV2(const uint8_t *buf, size_t len, V2Message *msg);
+
+#endif
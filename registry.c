@@ -0,0 +1,559 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "transfer.h"
+#include "latency.h"
+#include "log.h"
+
+#define INITIAL_CAPACITY 16 // Cars, name buckets and socket slots to start with
+
+Car **connected_cars = NULL;
+int num_cars = 0;
+int coarse_locking = 0;
+unsigned long registry_generation = 0;
+
+static int cars_capacity = 0;
+static int inactive_cars = 0; // Slots free for reuse, so registration only scans when there are some
+
+static Car **name_buckets = NULL; // Chained hash table on name, size is a power of two
+static int num_buckets = 0;
+
+static Car **by_socket = NULL; // by_socket[fd] is the active car on fd, or NULL
+static int by_socket_size = 0;
+
+// Range index: active cars grouped by floor range, groups sorted by lowest floor. A bank has
+// a handful of distinct ranges however many cars share them (low-rise, high-rise, shuttle,
+// basement...), so eligibility is decided per range instead of per car.
+typedef struct
+{
+    int lowest;
+    int highest;
+    Car **cars; // Slot order
+    int count;
+    int capacity;
+} RangeGroup;
+
+static RangeGroup *ranges = NULL;
+static int num_ranges = 0;
+static int ranges_capacity = 0;
+
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t cars_mutex = PTHREAD_MUTEX_INITIALIZER; // coarse_locking only
+
+// rebuildRouteGraph: give the transfer planner (--transfers) the distinct floor ranges
+static void rebuildRouteGraph(void)
+{
+    if (!transfers_enabled)
+        return;
+
+    int *lowest = malloc((num_ranges > 0 ? num_ranges : 1) * sizeof(int));
+    int *highest = malloc((num_ranges > 0 ? num_ranges : 1) * sizeof(int));
+    for (int g = 0; g < num_ranges; g++)
+    {
+        lowest[g] = ranges[g].lowest;
+        highest[g] = ranges[g].highest;
+    }
+    transferRebuild(lowest, highest, num_ranges);
+    free(lowest);
+    free(highest);
+}
+
+// registryInit: start with an empty registry, releasing any cars from a previous run
+void registryInit(void)
+{
+    for (int i = 0; i < num_cars; i++)
+    {
+        pthread_mutex_destroy(&connected_cars[i]->mutex);
+        for (int c = 0; c < connected_cars[i]->num_calls; c++)
+        {
+            free(connected_cars[i]->calls[c].onward);
+        }
+        free(connected_cars[i]->calls);
+        free(connected_cars[i]->latency);
+        free(connected_cars[i]);
+    }
+    free(connected_cars);
+    free(name_buckets);
+    free(by_socket);
+    for (int g = 0; g < num_ranges; g++)
+    {
+        free(ranges[g].cars);
+    }
+    free(ranges);
+    ranges = NULL;
+    num_ranges = ranges_capacity = 0;
+
+    cars_capacity = INITIAL_CAPACITY;
+    connected_cars = calloc(cars_capacity, sizeof(Car *));
+    num_cars = 0;
+    inactive_cars = 0;
+
+    num_buckets = INITIAL_CAPACITY;
+    name_buckets = calloc(num_buckets, sizeof(Car *));
+
+    by_socket_size = INITIAL_CAPACITY;
+    by_socket = calloc(by_socket_size, sizeof(Car *));
+    rebuildRouteGraph();
+}
+
+// This thread's holds of the registry lock and of a car's lock, for lockstat.h
+static __thread LockHold registry_hold;
+static __thread LockHold car_hold;
+
+// takeRegistry: lock the registry for reading or writing; with wait set, block until it is
+// free, otherwise only try. Returns 0 once locked.
+static int takeRegistry(int write, int wait)
+{
+    if (coarse_locking)
+        return wait ? pthread_mutex_lock(&cars_mutex) : pthread_mutex_trylock(&cars_mutex);
+    if (write)
+        return wait ? pthread_rwlock_wrlock(&registry_lock) : pthread_rwlock_trywrlock(&registry_lock);
+    return wait ? pthread_rwlock_rdlock(&registry_lock) : pthread_rwlock_tryrdlock(&registry_lock);
+}
+
+// lockRegistry: takeRegistry() as a lock site
+static void lockRegistry(LockSite *site, int write)
+{
+    if (lockstat_region == NULL)
+    {
+        takeRegistry(write, 1);
+        return;
+    }
+    if (site->lock == NULL)
+    {
+        // Every thread writes the same name
+        site->lock = coarse_locking ? "cars_mutex" : write ? "registry_lock write" : "registry_lock read";
+    }
+    if (takeRegistry(write, 0) == 0)
+    {
+        lockstatAcquired(site, &registry_hold, 0, 0);
+        return;
+    }
+    long start = lockstatNow();
+    takeRegistry(write, 1);
+    lockstatAcquired(site, &registry_hold, lockstatNow() - start, 1);
+}
+
+void registryReadLockAt(LockSite *site)
+{
+    lockRegistry(site, 0);
+}
+
+void registryWriteLockAt(LockSite *site)
+{
+    lockRegistry(site, 1);
+}
+
+void registryUnlock(void)
+{
+    if (lockstat_region != NULL)
+        lockstatReleased(&registry_hold);
+    if (coarse_locking)
+        pthread_mutex_unlock(&cars_mutex);
+    else
+        pthread_rwlock_unlock(&registry_lock);
+}
+
+void lockCarAt(Car *car, LockSite *site)
+{
+    if (!coarse_locking)
+        lockstatMutexLock(&car->mutex, site, &car_hold);
+}
+
+void unlockCar(Car *car)
+{
+    if (coarse_locking)
+        return;
+    if (lockstat_region != NULL)
+        lockstatReleased(&car_hold);
+    pthread_mutex_unlock(&car->mutex);
+}
+
+// hashName: FNV-1a
+static uint32_t hashName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p != '\0'; p++)
+    {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void addToNameIndex(Car *car)
+{
+    // Keep chains short: double the table once it holds as many cars as buckets
+    if (num_cars >= num_buckets)
+    {
+        int new_size = num_buckets * 2;
+        Car **new_buckets = calloc(new_size, sizeof(Car *));
+        for (int b = 0; b < num_buckets; b++)
+        {
+            Car *entry = name_buckets[b];
+            while (entry != NULL)
+            {
+                Car *next = entry->next_by_name;
+                uint32_t slot = hashName(entry->name) & (new_size - 1);
+                entry->next_by_name = new_buckets[slot];
+                new_buckets[slot] = entry;
+                entry = next;
+            }
+        }
+        free(name_buckets);
+        name_buckets = new_buckets;
+        num_buckets = new_size;
+    }
+
+    uint32_t slot = hashName(car->name) & (num_buckets - 1);
+    car->next_by_name = name_buckets[slot];
+    name_buckets[slot] = car;
+}
+
+static void removeFromNameIndex(Car *car)
+{
+    Car **link = &name_buckets[hashName(car->name) & (num_buckets - 1)];
+    while (*link != NULL && *link != car)
+    {
+        link = &(*link)->next_by_name;
+    }
+    if (*link == car)
+    {
+        *link = car->next_by_name;
+    }
+}
+
+static void setSocket(int sockfd, Car *car)
+{
+    if (sockfd < 0)
+        return;
+
+    if (sockfd >= by_socket_size)
+    {
+        int new_size = by_socket_size;
+        while (new_size <= sockfd)
+            new_size *= 2;
+        by_socket = realloc(by_socket, new_size * sizeof(Car *));
+        memset(by_socket + by_socket_size, 0, (new_size - by_socket_size) * sizeof(Car *));
+        by_socket_size = new_size;
+    }
+    by_socket[sockfd] = car;
+}
+
+// addToRangeIndex: file an active car under its floor range
+static void addToRangeIndex(Car *car)
+{
+    int g = 0;
+    while (g < num_ranges && (ranges[g].lowest < car->lowest_floor ||
+                              (ranges[g].lowest == car->lowest_floor && ranges[g].highest < car->highest_floor)))
+    {
+        g++;
+    }
+    if (g == num_ranges || ranges[g].lowest != car->lowest_floor || ranges[g].highest != car->highest_floor)
+    {
+        if (num_ranges == ranges_capacity)
+        {
+            ranges_capacity = ranges_capacity > 0 ? ranges_capacity * 2 : INITIAL_CAPACITY;
+            ranges = realloc(ranges, ranges_capacity * sizeof(RangeGroup));
+        }
+        memmove(&ranges[g + 1], &ranges[g], (num_ranges - g) * sizeof(RangeGroup));
+        num_ranges++;
+        ranges[g] = (RangeGroup){car->lowest_floor, car->highest_floor, NULL, 0, 0};
+    }
+
+    RangeGroup *group = &ranges[g];
+    if (group->count == group->capacity)
+    {
+        group->capacity = group->capacity > 0 ? group->capacity * 2 : 4;
+        group->cars = realloc(group->cars, group->capacity * sizeof(Car *));
+    }
+    int i = group->count;
+    while (i > 0 && group->cars[i - 1]->slot > car->slot)
+    {
+        group->cars[i] = group->cars[i - 1];
+        i--;
+    }
+    group->cars[i] = car;
+    group->count++;
+}
+
+// removeFromRangeIndex: drop a car that is no longer active, and its range once it is empty
+static void removeFromRangeIndex(Car *car)
+{
+    for (int g = 0; g < num_ranges; g++)
+    {
+        RangeGroup *group = &ranges[g];
+        if (group->lowest != car->lowest_floor || group->highest != car->highest_floor)
+            continue;
+
+        for (int i = 0; i < group->count; i++)
+        {
+            if (group->cars[i] == car)
+            {
+                memmove(&group->cars[i], &group->cars[i + 1], (group->count - i - 1) * sizeof(Car *));
+                group->count--;
+                break;
+            }
+        }
+        if (group->count == 0)
+        {
+            free(group->cars);
+            memmove(&ranges[g], &ranges[g + 1], (num_ranges - g - 1) * sizeof(RangeGroup));
+            num_ranges--;
+        }
+        return;
+    }
+}
+
+// This thread's scratch space for eligibility, sized to cars_capacity so a call allocates
+// nothing; freed when the thread exits
+typedef struct
+{
+    Car **cars;
+    uint64_t *marks; // All clear between calls
+    int capacity;
+} EligibleScratch;
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static __thread EligibleScratch *thread_scratch = NULL;
+
+// freeScratch: a thread with scratch space has exited
+static void freeScratch(void *arg)
+{
+    EligibleScratch *scratch = arg;
+    free(scratch->cars);
+    free(scratch->marks);
+    free(scratch);
+}
+
+static void makeScratchKey(void)
+{
+    pthread_key_create(&scratch_key, freeScratch);
+}
+
+// scratchForThread: this thread's scratch space, grown first if the registry has outgrown it.
+// The caller must hold the registry lock, so cars_capacity can't change under it.
+static EligibleScratch *scratchForThread(void)
+{
+    EligibleScratch *scratch = thread_scratch;
+    if (scratch != NULL && scratch->capacity >= cars_capacity)
+        return scratch;
+
+    if (scratch == NULL)
+    {
+        pthread_once(&scratch_once, makeScratchKey);
+        scratch = calloc(1, sizeof(EligibleScratch));
+        pthread_setspecific(scratch_key, scratch);
+        thread_scratch = scratch;
+    }
+    free(scratch->cars);
+    free(scratch->marks);
+    scratch->capacity = cars_capacity;
+    scratch->cars = malloc(cars_capacity * sizeof(Car *));
+    scratch->marks = calloc((cars_capacity + 63) / 64, sizeof(uint64_t));
+    return scratch;
+}
+
+Car **eligibleScratch(void)
+{
+    return scratchForThread()->cars;
+}
+
+int findEligibleCars(int source, int dest, Car **cars)
+{
+    int low = source < dest ? source : dest;
+    int high = source < dest ? dest : source;
+
+    int first = -1, groups = 0;
+    for (int g = 0; g < num_ranges && ranges[g].lowest <= low; g++)
+    {
+        if (ranges[g].highest < high)
+            continue;
+        if (groups++ == 0)
+            first = g;
+    }
+    if (groups == 0)
+        return 0;
+    if (groups == 1)
+    {
+        // Already in slot order
+        memcpy(cars, ranges[first].cars, ranges[first].count * sizeof(Car *));
+        return ranges[first].count;
+    }
+
+    // A mix of ranges: mark their slots, then read the marks back in order, clearing them
+    int words = (num_cars + 63) / 64;
+    uint64_t *marks = scratchForThread()->marks;
+    for (int g = first; g < num_ranges && ranges[g].lowest <= low; g++)
+    {
+        if (ranges[g].highest < high)
+            continue;
+        for (int i = 0; i < ranges[g].count; i++)
+        {
+            int slot = ranges[g].cars[i]->slot;
+            marks[slot / 64] |= 1ULL << (slot % 64);
+        }
+    }
+    int found = 0;
+    for (int w = 0; w < words; w++)
+    {
+        uint64_t bits = marks[w];
+        while (bits != 0)
+        {
+            cars[found++] = connected_cars[w * 64 + __builtin_ctzll(bits)];
+            bits &= bits - 1;
+        }
+        marks[w] = 0;
+    }
+    return found;
+}
+
+// findCarBySocket: active car registered on sockfd, or NULL
+Car *findCarBySocket(int sockfd)
+{
+    if (sockfd < 0 || sockfd >= by_socket_size)
+    {
+        return NULL;
+    }
+    return by_socket[sockfd];
+}
+
+// findCarByName: car registered under name (active or not), or NULL. There is at most one.
+Car *findCarByName(const char *name)
+{
+    Car *car = name_buckets[hashName(name) & (num_buckets - 1)];
+    while (car != NULL && strcmp(car->name, name) != 0)
+    {
+        car = car->next_by_name;
+    }
+    return car;
+}
+
+// takeFreeSlot: the car to reuse for a new registration: previous, the inactive car last
+// registered under the same name, else the first inactive car, else a freshly added one. Reusing
+// previous keeps one entry per name in the name index.
+static Car *takeFreeSlot(Car *previous)
+{
+    if (previous != NULL)
+    {
+        inactive_cars--;
+        removeFromNameIndex(previous);
+        return previous;
+    }
+    if (inactive_cars > 0)
+    {
+        for (int i = 0; i < num_cars; i++)
+        {
+            if (!connected_cars[i]->is_active)
+            {
+                inactive_cars--;
+                removeFromNameIndex(connected_cars[i]);
+                return connected_cars[i]; // Keeps its slot
+            }
+        }
+    }
+
+    if (num_cars == cars_capacity)
+    {
+        cars_capacity *= 2;
+        connected_cars = realloc(connected_cars, cars_capacity * sizeof(Car *));
+    }
+    Car *car = calloc(1, sizeof(Car));
+    pthread_mutex_init(&car->mutex, NULL);
+    car->slot = num_cars;
+    connected_cars[num_cars++] = car;
+    return car;
+}
+
+void handleCarRegistration(const char *car_name, const char *lowest_floor, const char *highest_floor,
+                           int sockfd, struct Connection *conn)
+{
+    registryWriteLock();
+
+    // Check if car already exists (reconnecting)
+    Car *car = findCarByName(car_name);
+    if (car != NULL && car->is_active)
+    {
+        if (findCarBySocket(car->sockfd) == car)
+        {
+            setSocket(car->sockfd, NULL);
+        }
+        car->sockfd = sockfd;
+        car->conn = conn;
+        setSocket(sockfd, car);
+        registryUnlock();
+        return;
+    }
+
+    // Register new car, in its old slot if it has been here before
+    car = takeFreeSlot(car);
+    strncpy(car->name, car_name, sizeof(car->name) - 1);
+    car->name[sizeof(car->name) - 1] = '\0';
+    car->is_active = 1;
+    car->sockfd = sockfd;
+    car->conn = conn;
+    car->current_floor = floor_to_int(lowest_floor);
+    car->destination_floor = floor_to_int(lowest_floor);
+    car->status = CAR_CLOSED;
+    car->lowest_floor = floor_to_int(lowest_floor);
+    car->highest_floor = floor_to_int(highest_floor);
+    stopSetInit(&car->stops);
+    car->peak_floor = floor_to_int(lowest_floor); // Initialize peak
+    car->zone_lowest = car->lowest_floor;
+    car->zone_highest = car->highest_floor;
+    car->park_checked = 0;
+    latencyReset(car);
+    addToNameIndex(car);
+    addToRangeIndex(car);
+    setSocket(sockfd, car);
+    registry_generation++;
+    rebuildRouteGraph();
+    logInfo("Registered new car: %s (Floors: %s to %s)\n", car_name, lowest_floor, highest_floor);
+
+    registryUnlock();
+}
+
+// handleCarDisconnect: mark the car attached to sockfd as inactive, then redispatch the calls it
+// owed. A car that sends INDIVIDUAL SERVICE or EMERGENCY goes through here first, so its
+// disconnect afterwards finds nothing left to do.
+void handleCarDisconnect(const char *car_name, int sockfd, const char *reason)
+{
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    logInfo("Car %s %s\n", car_name, reason);
+    CarCall *owed = NULL;
+    int num_owed = 0, at = 0;
+    registryWriteLock();
+    Car *car = findCarBySocket(sockfd);
+    if (car != NULL)
+    {
+        car->is_active = 0;
+        car->conn = NULL;
+        removeFromRangeIndex(car);
+        setSocket(sockfd, NULL);
+        inactive_cars++;
+        registry_generation++;
+        rebuildRouteGraph();
+
+        // Nobody else can be holding the car's lock while the registry is write-locked
+        owed = car->calls;
+        num_owed = car->num_calls;
+        at = car->current_floor;
+        car->calls = NULL;
+        car->num_calls = car->calls_capacity = 0;
+        stopSetInit(&car->stops);
+    }
+    registryUnlock();
+
+    if (num_owed > 0)
+    {
+        reassignCalls(car_name, owed, num_owed, at, &started);
+    }
+    free(owed);
+}
@@ -0,0 +1,124 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <pthread.h>
+#include "protocol.h"
+#include "stopset.h"
+#include "lockstat.h"
+
+// Registry of cars known to the controller.
+//
+// Locking: registry_lock (reader-writer) is write-locked only to register or
+// unregister a car, which are the only times name, is_active, sockfd, conn and
+// the floor range change. Everything else takes it for reading, so lookups and
+// eligibility checks never block each other. The rest of a car's state
+// (status, floors, stops, peak, calls, zone, latency) is protected by that car's own mutex, so
+// STATUS updates for different cars run in parallel. --zones rewrites every car's zone under
+// its mutex, so dispatch never sees half of a new zone.
+//
+// Cars live in a growable array (registration order, which dispatch scans in)
+// and are also indexed by name (hash table) and by socket (array indexed by
+// fd), so lookups cost the same for ten cars or ten thousand. Active cars are
+// also indexed by floor range, for findEligibleCars(). A Car never
+// moves once allocated, so pointers to it stay valid while the lock is held.
+//
+// With coarse_locking set, every registry lock is one global mutex and the
+// per-car mutexes are skipped - the old single cars_mutex design, kept so the
+// two can be compared.
+//
+// With LOCKSTAT=1, each place that takes the registry lock or a car's lock is
+// a lock site with its own wait and hold times (see lockstat.h).
+
+struct Connection; // Owned by the network layer
+struct OnwardTrip; // See dispatch.c
+
+// A call a car has accepted and not yet finished: its passenger is waiting at source, or on
+// board (picked_up) until dest
+typedef struct
+{
+    int source;
+    int dest;
+    int picked_up;
+    long called_us;    // latency_clock() when the passenger called, -1 to leave out of the wait times
+    long picked_up_us; // latency_clock() when the car opened for them at source
+    struct OnwardTrip *onward; // --transfers: the legs after this one, booked once it drops them off
+} CarCall;
+
+struct LatencyHistograms; // See latency.h
+
+typedef struct Car
+{
+    pthread_mutex_t mutex; // Protects status, floors, stops, peak, calls, zone and latency
+    struct Car *next_by_name; // Hash chain, owned by the registry
+
+    char name[50];
+    int is_active;
+    int sockfd;
+    struct Connection *conn; // Connection the car is registered on, NULL once it disconnects
+    int slot;                // Position in connected_cars, so registration order
+
+    int lowest_floor;
+    int highest_floor;
+
+    // Last STATUS from the car, floors as from floor_to_int()
+    int current_floor;
+    int destination_floor;
+    CarStatus status;
+
+    StopSet stops; // Pending stops in route order
+    int peak_floor; // Highest floor in current journey (turning point)
+
+    // Calls it owes, so they can be handed to other cars if it leaves service
+    CarCall *calls;
+    int num_calls;
+    int calls_capacity;
+
+    // Floors --zones keeps this car to (see zoning.h), within its range
+    int zone_lowest;
+    int zone_highest;
+
+    int park_checked; // --park has considered moving it since it last went idle
+
+    struct LatencyHistograms *latency; // Its calls' timings, NULL until it has any
+
+} Car;
+
+// All cars ever registered, active or not, in registration order.
+// Read under the registry lock; may be reallocated by registration.
+extern Car **connected_cars;
+extern int num_cars;
+extern int coarse_locking;
+extern unsigned long registry_generation; // Bumped whenever a car registers or disconnects
+
+void registryInit(void);
+void registryReadLockAt(LockSite *site);
+void registryWriteLockAt(LockSite *site);
+void registryUnlock(void);
+void lockCarAt(Car *car, LockSite *site);
+void unlockCar(Car *car);
+
+// Each caller is its own lock site; the lock's name is filled in on first use
+#define registryReadLock() registryReadLockAt(LOCKSTAT_HERE(NULL))
+#define registryWriteLock() registryWriteLockAt(LOCKSTAT_HERE(NULL))
+#define lockCar(car) lockCarAt((car), LOCKSTAT_HERE("Car.mutex"))
+
+// Lookups; the caller must hold the registry lock
+Car *findCarBySocket(int sockfd);
+Car *findCarByName(const char *name);
+
+// findEligibleCars: the active cars that serve both floors, in registration order, without
+// looking at any car that doesn't. cars must have room for num_cars. Returns how many.
+// The caller must hold the registry lock.
+int findEligibleCars(int source, int dest, Car **cars);
+
+// eligibleScratch: this thread's own buffer with room for num_cars cars, for findEligibleCars()
+// without an allocation per call. Only valid while the registry lock is held.
+Car **eligibleScratch(void);
+
+void handleCarRegistration(const char *car_name, const char *lowest_floor, const char *highest_floor,
+                           int sockfd, struct Connection *conn);
+// handleCarDisconnect: take the car on sockfd out of dispatch ("disconnected", "entered
+// emergency mode", ...) and hand the calls it still owed to the other cars
+void handleCarDisconnect(const char *car_name, int sockfd, const char *reason);
+
+#endif
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include "shared.h"
+#include "lockstat.h"
 
 /* Safety System Return Codes */
 #define SAFETY_SUCCESS 0
@@ -168,6 +169,14 @@ int main(int argc, char *argv[])
         return SAFETY_ERROR_SHM;
     }
 
+    // Lock statistics (LOCKSTAT=1) are optional; failing to set them up is not a safety fault
+    char lockstat_name[MAX_CAR_NAME + 8];
+    (void)snprintf(lockstat_name, sizeof(lockstat_name), "safety-%s", car_name);
+    if (lockstatInit(lockstat_name) != 0)
+    {
+        fprintf(stderr, "Lock statistics unavailable: %s\n", strerror(errno));
+    }
+
     // Open shared memory
     const int fd = shm_open(shm_name, O_RDWR, 0666);
     if (fd == -1)
@@ -195,7 +204,7 @@ int main(int argc, char *argv[])
     for (;;)
     {
         //  MISRA C Exception: Use of pthread functions
-        const int lock_result = pthread_mutex_lock(&shm_ptr->mutex);
+        const int lock_result = LOCKSTAT_LOCK(&shm_ptr->mutex, LOCKSTAT_SHM_MUTEX);
         if (lock_result != 0)
         {
             fprintf(stderr, "Mutex lock failed: %s\n", strerror(lock_result));
@@ -203,10 +212,10 @@ int main(int argc, char *argv[])
         }
 
         // MISRA C Exception: Use of pthread functions
-        const int wait_result = pthread_cond_wait(&shm_ptr->cond, &shm_ptr->mutex);
+        const int wait_result = lockstatCondWait(&shm_ptr->cond, &shm_ptr->mutex);
         if (wait_result != 0)
         {
-            pthread_mutex_unlock(&shm_ptr->mutex);
+            lockstatUnlock(&shm_ptr->mutex);
             fprintf(stderr, "Condition wait failed: %s\n", strerror(wait_result));
             continue;
         }
@@ -296,7 +305,7 @@ int main(int argc, char *argv[])
             }
         }
 
-        pthread_mutex_unlock(&shm_ptr->mutex);
+        lockstatUnlock(&shm_ptr->mutex);
     }
 
     // Cleanup on exit - should not be reached due to infinite loop
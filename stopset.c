@@ -0,0 +1,235 @@
+#include <string.h>
+#include "stopset.h"
+
+#define NO_STOP -1
+
+// floorIndex / indexFloor: bit position of a floor and back
+static int floorIndex(int floor)
+{
+    return floor - STOP_MIN_FLOOR;
+}
+
+static int indexFloor(int index)
+{
+    return index + STOP_MIN_FLOOR;
+}
+
+static int inRange(int floor)
+{
+    return floor >= STOP_MIN_FLOOR && floor <= STOP_MAX_FLOOR;
+}
+
+static int testBit(const FloorBitmap *bm, int index)
+{
+    return (bm->bits[index / 64] >> (index % 64)) & 1;
+}
+
+static void setBit(FloorBitmap *bm, int index)
+{
+    bm->bits[index / 64] |= (uint64_t)1 << (index % 64);
+    bm->count++;
+}
+
+static void clearBit(FloorBitmap *bm, int index)
+{
+    bm->bits[index / 64] &= ~((uint64_t)1 << (index % 64));
+    bm->count--;
+}
+
+// firstAtOrAbove: lowest set bit >= index, or NO_STOP
+static int firstAtOrAbove(const FloorBitmap *bm, int index)
+{
+    if (bm->count == 0 || index >= STOP_FLOORS)
+        return NO_STOP;
+    if (index < 0)
+        index = 0;
+
+    int w = index / 64;
+    uint64_t word = bm->bits[w] & (~(uint64_t)0 << (index % 64));
+    while (word == 0)
+    {
+        if (++w == STOP_WORDS)
+            return NO_STOP;
+        word = bm->bits[w];
+    }
+    return w * 64 + __builtin_ctzll(word);
+}
+
+// lastAtOrBelow: highest set bit <= index, or NO_STOP
+static int lastAtOrBelow(const FloorBitmap *bm, int index)
+{
+    if (bm->count == 0 || index < 0)
+        return NO_STOP;
+    if (index >= STOP_FLOORS)
+        index = STOP_FLOORS - 1;
+
+    int w = index / 64;
+    int shift = 63 - index % 64;
+    uint64_t word = (bm->bits[w] << shift) >> shift;
+    while (word == 0)
+    {
+        if (--w < 0)
+            return NO_STOP;
+        word = bm->bits[w];
+    }
+    return w * 64 + 63 - __builtin_clzll(word);
+}
+
+void stopSetInit(StopSet *stops)
+{
+    memset(stops, 0, sizeof(*stops));
+}
+
+int stopSetCount(const StopSet *stops)
+{
+    return stops->ascent.count + stops->descent.count;
+}
+
+int stopSetContains(const StopSet *stops, int floor)
+{
+    if (!inRange(floor))
+        return 0;
+    int i = floorIndex(floor);
+    return testBit(&stops->ascent, i) || testBit(&stops->descent, i);
+}
+
+// nearestDistance: floors from index to the closest set bit, or -1
+static int nearestDistance(const FloorBitmap *bm, int index)
+{
+    int above = firstAtOrAbove(bm, index);
+    int below = lastAtOrBelow(bm, index);
+    int best = -1;
+    if (above != NO_STOP)
+        best = above - index;
+    if (below != NO_STOP && (best == -1 || index - below < best))
+        best = index - below;
+    return best;
+}
+
+int stopSetDistance(const StopSet *stops, int floor)
+{
+    if (floor < STOP_MIN_FLOOR)
+        floor = STOP_MIN_FLOOR;
+    if (floor > STOP_MAX_FLOOR)
+        floor = STOP_MAX_FLOOR;
+    int up = nearestDistance(&stops->ascent, floorIndex(floor));
+    int down = nearestDistance(&stops->descent, floorIndex(floor));
+    if (up == -1 || (down != -1 && down < up))
+        return down;
+    return up;
+}
+
+// addToAscent: set an ascent bit, moving the head or peak if it is a new end
+static void addToAscent(StopSet *stops, int floor)
+{
+    if (stops->ascent.count == 0)
+    {
+        stops->head = floor;
+        stops->peak = floor;
+    }
+    else if (floor < stops->head)
+    {
+        stops->head = floor;
+    }
+    else if (floor > stops->peak)
+    {
+        stops->peak = floor;
+    }
+    setBit(&stops->ascent, floorIndex(floor));
+}
+
+void stopSetAddAscent(StopSet *stops, int floor)
+{
+    if (!inRange(floor) || stopSetContains(stops, floor))
+        return;
+    addToAscent(stops, floor);
+}
+
+void stopSetAddDescent(StopSet *stops, int floor)
+{
+    if (!inRange(floor) || stopSetContains(stops, floor))
+        return;
+
+    if (stops->ascent.count == 0 || floor > stops->peak)
+    {
+        addToAscent(stops, floor);
+    }
+    else
+    {
+        if (stops->descent.count == 0 || floor < stops->trough)
+        {
+            stops->trough = floor;
+        }
+        setBit(&stops->descent, floorIndex(floor));
+    }
+}
+
+int stopSetHead(const StopSet *stops)
+{
+    return stops->head;
+}
+
+int stopSetPeak(const StopSet *stops)
+{
+    return stops->peak;
+}
+
+int stopSetTrough(const StopSet *stops)
+{
+    return stops->descent.count > 0 ? stops->trough : stops->peak;
+}
+
+void stopSetPop(StopSet *stops)
+{
+    if (stops->ascent.count == 0)
+        return;
+
+    int head = floorIndex(stops->head);
+    clearBit(&stops->ascent, head);
+
+    if (stops->ascent.count > 0)
+    {
+        // Next ascent stop is above the old head, at most the peak
+        stops->head = indexFloor(firstAtOrAbove(&stops->ascent, head + 1));
+    }
+    else if (stops->descent.count > 0)
+    {
+        // Past the peak: the top of the descent is the new turning point
+        int top = lastAtOrBelow(&stops->descent, floorIndex(stops->peak) - 1);
+        clearBit(&stops->descent, top);
+        setBit(&stops->ascent, top);
+        stops->head = indexFloor(top);
+        stops->peak = stops->head;
+    }
+}
+
+void stopSetBegin(const StopSet *stops, StopCursor *cursor)
+{
+    (void)stops;
+    cursor->descending = 0;
+    cursor->floor = STOP_MIN_FLOOR - 1;
+}
+
+int stopSetNext(const StopSet *stops, StopCursor *cursor, int *floor)
+{
+    int index;
+    if (!cursor->descending)
+    {
+        index = firstAtOrAbove(&stops->ascent, floorIndex(cursor->floor) + 1);
+        if (index != NO_STOP)
+        {
+            cursor->floor = indexFloor(index);
+            *floor = cursor->floor;
+            return 1;
+        }
+        cursor->descending = 1;
+        cursor->floor = STOP_MAX_FLOOR + 1;
+    }
+
+    index = lastAtOrBelow(&stops->descent, floorIndex(cursor->floor) - 1);
+    if (index == NO_STOP)
+        return 0;
+    cursor->floor = indexFloor(index);
+    *floor = cursor->floor;
+    return 1;
+}
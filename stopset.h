@@ -0,0 +1,76 @@
+#ifndef STOPSET_H
+#define STOPSET_H
+
+#include <stdint.h>
+
+// A car's pending stops, in SCAN order: up the ascent to its peak, then down
+// the descent.
+//
+// The route is kept as two bitmaps over every floor a car can serve (B99 to
+// 999), one bit per floor. The ascent holds the stops visited on the way up,
+// lowest first, ending at the peak (its highest stop); the descent holds the
+// stops after the peak, highest first, all below it. Insert, lookup and pop
+// touch one bit; finding the next stop is a word-at-a-time scan of at most
+// STOP_WORDS words. No memory is allocated, so the set lives inside the Car.
+//
+// The ascent is never empty while the descent has stops: popping the last
+// ascent stop moves the descent's highest stop (the new peak) across.
+//
+// The head, peak and trough are kept up to date as stops come and go, so
+// reading them is O(1). Only a pop searches, and only from the stop it removed
+// to the next one.
+
+#define STOP_MIN_FLOOR -99
+#define STOP_MAX_FLOOR 999
+#define STOP_FLOORS (STOP_MAX_FLOOR - STOP_MIN_FLOOR + 1)
+#define STOP_WORDS ((STOP_FLOORS + 63) / 64)
+
+typedef struct
+{
+    uint64_t bits[STOP_WORDS];
+    int count;
+} FloorBitmap;
+
+typedef struct
+{
+    FloorBitmap ascent;
+    FloorBitmap descent;
+    int head;   // Lowest ascent stop: the next stop
+    int peak;   // Highest ascent stop: where the car turns to go down
+    int trough; // Lowest descent stop: where a down-journey ends
+} StopSet;
+
+// Walks a StopSet in route order; start it with stopSetBegin()
+typedef struct
+{
+    int descending; // 0 while in the ascent
+    int floor;      // Last floor returned
+} StopCursor;
+
+void stopSetInit(StopSet *stops);
+int stopSetCount(const StopSet *stops);
+int stopSetContains(const StopSet *stops, int floor);
+
+// stopSetDistance: floors from floor to the nearest stop, -1 if there are none
+int stopSetDistance(const StopSet *stops, int floor);
+
+// Add a stop to the ascent / descent. A descent stop above the peak extends
+// the ascent instead, as it would be reached before turning around. Floors
+// already in the set, or outside B99..999, are ignored.
+void stopSetAddAscent(StopSet *stops, int floor);
+void stopSetAddDescent(StopSet *stops, int floor);
+
+// Next stop, highest stop and last stop down of the route (the peak if there
+// is no descent); the set must not be empty
+int stopSetHead(const StopSet *stops);
+int stopSetPeak(const StopSet *stops);
+int stopSetTrough(const StopSet *stops);
+
+// stopSetPop: remove the next stop (no-op on an empty set)
+void stopSetPop(StopSet *stops);
+
+// Route-order iteration: returns 1 and sets *floor for each stop, then 0
+void stopSetBegin(const StopSet *stops, StopCursor *cursor);
+int stopSetNext(const StopSet *stops, StopCursor *cursor, int *floor);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "zoning.h"
+#include "traffic.h"
+#include "log.h"
+
+#define TRAFFIC_WINDOW 64         // Recent calls the pattern is judged on
+#define TRAFFIC_MIN_CALLS 16      // Calls needed before judging at all
+#define TRAFFIC_CLASSIFY_EVERY 8  // Calls between judgements
+#define TRAFFIC_LIGHT_RATE 6.0    // Calls a minute per car below which traffic is light
+#define TRAFFIC_PEAK_SHARE 0.6    // Share of calls from (or to) the lobby that makes a peak
+#define TRAFFIC_TWO_WAY_SHARE 0.25 // Share each way that makes two-way traffic
+#define TRAFFIC_HISTORY 16        // Switches remembered for the admin tool
+
+typedef struct
+{
+    int source;
+    int dest;
+    long at_ms;
+} RecentCall;
+
+typedef struct
+{
+    TrafficPattern pattern;
+    long at_ms;
+} TrafficSwitch;
+
+// What each pattern switches to, chosen by running each pattern on its own through
+// bench/bench-adaptive's simulated fleet and taking the policy with the shortest journeys
+typedef struct
+{
+    DispatchMode mode;
+    int zones;
+} TrafficPolicy;
+
+static const TrafficPolicy policies[] = {
+    [TRAFFIC_LIGHT] = {DISPATCH_GROUP, 1},     // Little to choose, so ready for the next peak
+    [TRAFFIC_UP_PEAK] = {DISPATCH_GROUP, 1},   // Fill cars at the lobby by destination zone
+    [TRAFFIC_DOWN_PEAK] = {DISPATCH_ETA, 0},   // Cars fill up on the way down anyway
+    [TRAFFIC_TWO_WAY] = {DISPATCH_GROUP, 1},
+    [TRAFFIC_INTERFLOOR] = {DISPATCH_GROUP, 1},
+};
+
+static const char *pattern_names[] = {"light", "up-peak", "down-peak", "two-way", "interfloor"};
+
+static long monotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+int traffic_adaptive = 0;
+long (*traffic_clock)(void) = monotonicMs;
+
+static pthread_mutex_t traffic_mutex = PTHREAD_MUTEX_INITIALIZER;
+static RecentCall recent[TRAFFIC_WINDOW]; // Ring, oldest at recent_next once full
+static int recent_count;
+static int recent_next;
+static unsigned long total_calls;
+static TrafficPattern current;
+static TrafficPattern candidate; // Last judgement, waiting to be confirmed
+static TrafficSwitch history[TRAFFIC_HISTORY]; // Ring of the latest switches
+static int num_switches;
+
+// Figures from the last judgement, for trafficDescribe()
+static int last_lobby;
+static double last_up, last_down, last_rate;
+
+// applyPolicy: set the dispatch policy for a pattern. Called with traffic_mutex held.
+static void applyPolicy(TrafficPattern pattern)
+{
+    const TrafficPolicy *policy = &policies[pattern];
+    __atomic_store_n(&dispatch_mode, policy->mode, __ATOMIC_RELAXED);
+    if (policy->zones && !zoning_enabled)
+    {
+        zoningInit(); // Zones from before are stale by now
+    }
+    __atomic_store_n(&zoning_enabled, policy->zones, __ATOMIC_RELAXED);
+}
+
+void trafficInit(void)
+{
+    pthread_mutex_lock(&traffic_mutex);
+    recent_count = recent_next = 0;
+    total_calls = 0;
+    num_switches = 0;
+    current = candidate = TRAFFIC_LIGHT;
+    last_lobby = 0;
+    last_up = last_down = last_rate = 0;
+    applyPolicy(current);
+    pthread_mutex_unlock(&traffic_mutex);
+}
+
+// activeCars: cars dispatch can use right now
+static int activeCars(void)
+{
+    int active = 0;
+    registryReadLock();
+    for (int i = 0; i < num_cars; i++)
+        active += connected_cars[i]->is_active;
+    registryUnlock();
+    return active;
+}
+
+// classify: judge the calls in the window. Called with traffic_mutex held.
+static TrafficPattern classify(void)
+{
+    // The lobby is the floor the most calls start or end at
+    int lobby = recent[0].source, lobby_count = 0;
+    for (int i = 0; i < recent_count; i++)
+    {
+        int floors[2] = {recent[i].source, recent[i].dest};
+        for (int e = 0; e < 2; e++)
+        {
+            int count = 0;
+            for (int j = 0; j < recent_count; j++)
+                count += (recent[j].source == floors[e]) + (recent[j].dest == floors[e]);
+            if (count > lobby_count || (count == lobby_count && floors[e] < lobby))
+            {
+                lobby = floors[e];
+                lobby_count = count;
+            }
+        }
+    }
+
+    int from_lobby = 0, to_lobby = 0;
+    long first = recent[0].at_ms, last = recent[0].at_ms;
+    for (int i = 0; i < recent_count; i++)
+    {
+        from_lobby += recent[i].source == lobby;
+        to_lobby += recent[i].dest == lobby;
+        if (recent[i].at_ms < first)
+            first = recent[i].at_ms;
+        if (recent[i].at_ms > last)
+            last = recent[i].at_ms;
+    }
+
+    int cars = activeCars();
+    double minutes = (last - first) / 60000.0;
+    last_lobby = lobby;
+    last_up = (double)from_lobby / recent_count;
+    last_down = (double)to_lobby / recent_count;
+    last_rate = minutes > 0 ? (recent_count - 1) / minutes / (cars > 0 ? cars : 1) : 0;
+
+    if (minutes > 0 && last_rate < TRAFFIC_LIGHT_RATE)
+        return TRAFFIC_LIGHT;
+    if (last_up >= TRAFFIC_PEAK_SHARE)
+        return TRAFFIC_UP_PEAK;
+    if (last_down >= TRAFFIC_PEAK_SHARE)
+        return TRAFFIC_DOWN_PEAK;
+    if (last_up >= TRAFFIC_TWO_WAY_SHARE && last_down >= TRAFFIC_TWO_WAY_SHARE)
+        return TRAFFIC_TWO_WAY;
+    return TRAFFIC_INTERFLOOR;
+}
+
+void trafficRecordCall(int source, int dest)
+{
+    pthread_mutex_lock(&traffic_mutex);
+    long now = traffic_clock();
+    recent[recent_next] = (RecentCall){source, dest, now};
+    recent_next = (recent_next + 1) % TRAFFIC_WINDOW;
+    if (recent_count < TRAFFIC_WINDOW)
+        recent_count++;
+    total_calls++;
+
+    if (recent_count >= TRAFFIC_MIN_CALLS && total_calls % TRAFFIC_CLASSIFY_EVERY == 0)
+    {
+        TrafficPattern seen = classify();
+        if (seen != current && seen == candidate)
+        {
+            // Seen twice running: switch
+            logInfo("Traffic is now %s (was %s), %.1f calls a minute per car\n",
+                    pattern_names[seen], pattern_names[current], last_rate);
+            current = seen;
+            history[num_switches % TRAFFIC_HISTORY] = (TrafficSwitch){seen, now};
+            num_switches++;
+            applyPolicy(current);
+        }
+        candidate = seen;
+    }
+    pthread_mutex_unlock(&traffic_mutex);
+}
+
+void trafficDescribe(char *buf, size_t size)
+{
+    if (!traffic_adaptive)
+    {
+        snprintf(buf, size, "TRAFFIC disabled");
+        return;
+    }
+
+    pthread_mutex_lock(&traffic_mutex);
+    long now = traffic_clock();
+    char lobby[8];
+    int_to_floor(last_lobby, lobby);
+    size_t len = snprintf(buf, size,
+                          "TRAFFIC pattern=%s dispatch=%s%s calls=%lu lobby=%s from_lobby=%.2f to_lobby=%.2f "
+                          "rate=%.1f switches=%d history=",
+                          pattern_names[current], dispatch_mode == DISPATCH_GROUP ? "group" : "eta",
+                          zoning_enabled ? "+zones" : "", total_calls, lobby, last_up, last_down, last_rate,
+                          num_switches);
+
+    // Oldest remembered switch first, times in seconds ago
+    int first = num_switches > TRAFFIC_HISTORY ? num_switches - TRAFFIC_HISTORY : 0;
+    for (int i = first; i < num_switches && len < size; i++)
+    {
+        const TrafficSwitch *change = &history[i % TRAFFIC_HISTORY];
+        len += snprintf(buf + len, size - len, "%s%s@-%.1fs", i > first ? "," : "",
+                        pattern_names[change->pattern], (now - change->at_ms) / 1000.0);
+    }
+    if (num_switches == 0 && len < size)
+        snprintf(buf + len, size - len, "none");
+    pthread_mutex_unlock(&traffic_mutex);
+}
@@ -0,0 +1,51 @@
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <stddef.h>
+
+// Traffic-pattern detection (--adaptive): watch the recent calls and switch
+// the dispatch policy to suit the time of day.
+//
+// The last TRAFFIC_WINDOW calls are kept with the time they arrived. Every
+// few calls they are classified: the lobby is the floor most of them start
+// or end at, and the shares going from and to it, plus the arrival rate per
+// car, decide the pattern. A new pattern has to be seen twice running before
+// the policy changes, so one odd call can't flip it back and forth.
+//
+//   light       fewer than TRAFFIC_LIGHT_RATE calls a minute per car
+//   up-peak     most calls start at the lobby (the morning rush)
+//   down-peak   most calls end at the lobby (the evening rush)
+//   two-way     plenty both ways (lunchtime)
+//   interfloor  neither
+//
+// Each pattern has its own dispatch mode and zoning (see policies in
+// traffic.c), so --adaptive overrides --group and --zones. Every switch is
+// kept in a short history, reported with the active pattern by the TRAFFIC
+// admin command.
+
+typedef enum
+{
+    TRAFFIC_LIGHT,
+    TRAFFIC_UP_PEAK,
+    TRAFFIC_DOWN_PEAK,
+    TRAFFIC_TWO_WAY,
+    TRAFFIC_INTERFLOOR
+} TrafficPattern;
+
+extern int traffic_adaptive; // Set by --adaptive
+
+// Milliseconds on a monotonic clock; the fleet simulator swaps in its own step clock
+extern long (*traffic_clock)(void);
+
+// trafficInit: forget all calls and history and start out in light traffic
+void trafficInit(void);
+
+// trafficRecordCall: add a call to the window, and switch policy if the pattern has changed.
+// Called without the registry lock held.
+void trafficRecordCall(int source, int dest);
+
+// trafficDescribe: "TRAFFIC pattern=... switches=... history=..." for the admin tool,
+// or "TRAFFIC disabled"
+void trafficDescribe(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+#include "transfer.h"
+
+int transfers_enabled = 0;
+
+// An edge of the route graph: the floors two ranges share
+typedef struct
+{
+    int to; // Range index
+    int lowest;
+    int highest;
+} Overlap;
+
+typedef struct
+{
+    int lowest;
+    int highest;
+    Overlap *overlaps;
+    int num_overlaps;
+} RangeNode;
+
+// Rebuilt under the registry write lock, read under its read lock
+static RangeNode *nodes = NULL;
+static int num_nodes = 0;
+
+static int contains(const RangeNode *node, int floor)
+{
+    return floor >= node->lowest && floor <= node->highest;
+}
+
+// clampFloor: the floor in lowest..highest nearest to floor
+static int clampFloor(int floor, int lowest, int highest)
+{
+    return floor < lowest ? lowest : floor > highest ? highest : floor;
+}
+
+void transferRebuild(const int *lowest, const int *highest, int count)
+{
+    for (int n = 0; n < num_nodes; n++)
+    {
+        free(nodes[n].overlaps);
+    }
+    free(nodes);
+
+    nodes = malloc((count > 0 ? count : 1) * sizeof(RangeNode));
+    num_nodes = count;
+    for (int n = 0; n < count; n++)
+    {
+        nodes[n] = (RangeNode){lowest[n], highest[n], NULL, 0};
+    }
+
+    for (int a = 0; a < num_nodes; a++)
+    {
+        nodes[a].overlaps = malloc((num_nodes > 0 ? num_nodes : 1) * sizeof(Overlap));
+        for (int b = 0; b < num_nodes; b++)
+        {
+            int lowest = nodes[a].lowest > nodes[b].lowest ? nodes[a].lowest : nodes[b].lowest;
+            int highest = nodes[a].highest < nodes[b].highest ? nodes[a].highest : nodes[b].highest;
+            if (a != b && lowest <= highest)
+            {
+                nodes[a].overlaps[nodes[a].num_overlaps++] = (Overlap){b, lowest, highest};
+            }
+        }
+    }
+}
+
+// addRoute: keep a route unless a leg goes nowhere, it is already listed or the list is full
+static void addRoute(TransferRoute *routes, int *count, int max, const int *floors, int num_legs)
+{
+    for (int l = 0; l < num_legs; l++)
+    {
+        if (floors[l] == floors[l + 1])
+            return;
+    }
+    for (int r = 0; r < *count; r++)
+    {
+        if (routes[r].num_legs == num_legs &&
+            memcmp(routes[r].floors, floors, (num_legs + 1) * sizeof(int)) == 0)
+            return;
+    }
+    if (*count == max)
+        return;
+    routes[*count].num_legs = num_legs;
+    memcpy(routes[*count].floors, floors, (num_legs + 1) * sizeof(int));
+    (*count)++;
+}
+
+int transferRoutes(int source, int dest, TransferRoute *routes, int max)
+{
+    int count = 0;
+    for (int a = 0; a < num_nodes; a++)
+    {
+        if (!contains(&nodes[a], source))
+            continue;
+
+        for (int e = 0; e < nodes[a].num_overlaps; e++)
+        {
+            const Overlap *first = &nodes[a].overlaps[e];
+            const RangeNode *middle = &nodes[first->to];
+
+            // Two legs: change once, as early or as late as the shared floors allow
+            if (contains(middle, dest))
+            {
+                int floors[3] = {source, 0, dest};
+                floors[1] = clampFloor(source, first->lowest, first->highest);
+                addRoute(routes, &count, max, floors, 2);
+                floors[1] = clampFloor(dest, first->lowest, first->highest);
+                addRoute(routes, &count, max, floors, 2);
+                continue;
+            }
+            if (contains(middle, source))
+                continue; // Its own two-leg routes cover it
+
+            // Three legs, through a range that serves neither end
+            for (int f = 0; f < middle->num_overlaps; f++)
+            {
+                const Overlap *second = &middle->overlaps[f];
+                if (!contains(&nodes[second->to], dest))
+                    continue;
+                int floors[4] = {source, 0, 0, dest};
+                for (int early = 0; early < 2; early++)
+                {
+                    floors[1] = clampFloor(early ? source : dest, first->lowest, first->highest);
+                    floors[2] = clampFloor(early ? floors[1] : dest, second->lowest, second->highest);
+                    addRoute(routes, &count, max, floors, 3);
+                }
+            }
+        }
+    }
+    return count;
+}
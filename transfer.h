@@ -0,0 +1,39 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+// Multi-leg trips (--transfers): when no car serves both floors of a call,
+// carry the passenger in two or three legs, changing cars at floors where
+// their ranges meet (a sky lobby, say).
+//
+// The route graph has one node per distinct floor range among the active
+// cars, and an edge wherever two ranges share floors. It is rebuilt by the
+// registry whenever a car registers or disconnects, so a call only looks up
+// the ranges around its two floors. For each pair of ranges a passenger can
+// change between, transfers are tried at both ends of the shared floors
+// nearest the trip, so every sensible route is costed without trying every
+// floor of a long overlap. Dispatch (assignTrip()) costs each leg on the
+// cars that can serve it, from when the passenger gets there, and books the
+// quickest route one leg at a time as they change cars.
+
+#define TRANSFER_MAX_LEGS 3
+#define TRANSFER_MAX_ROUTES 32 // Routes tried per call
+
+extern int transfers_enabled; // Set by --transfers
+
+// One way to make a trip: floors[0] is the source, floors[num_legs] the destination, and the
+// floors between are where the passenger changes cars
+typedef struct
+{
+    int num_legs;
+    int floors[TRANSFER_MAX_LEGS + 1];
+} TransferRoute;
+
+// transferRebuild: recompute the route graph from the active cars' distinct floor ranges.
+// Called by the registry, write-locked.
+void transferRebuild(const int *lowest, const int *highest, int count);
+
+// transferRoutes: up to max routes of two or three legs from source to dest, in no particular
+// order. Returns how many. Called with the registry lock held.
+int transferRoutes(int source, int dest, TransferRoute *routes, int max);
+
+#endif
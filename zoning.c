@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "registry.h"
+#include "dispatch.h"
+#include "zoning.h"
+#include "log.h"
+
+#define ZONE_REBALANCE_CALLS 32 // Calls between rebalances
+#define ZONE_DECAY 0.5          // Share of the old demand kept at each rebalance
+#define ZONE_BASELINE 0.1       // Demand every floor starts with, so a quiet building splits evenly
+#define ZONE_MAX_SECTORS 64     // Beyond this many cars, cars share sectors
+
+int zoning_enabled = 0;
+
+// Lock order: zone_mutex, then the registry, then a car
+static pthread_mutex_t zone_mutex = PTHREAD_MUTEX_INITIALIZER;
+static double demand[STOP_FLOORS]; // Calls by highest floor of the trip, less STOP_MIN_FLOOR
+static int calls_since_rebalance = 0;
+static unsigned long seen_generation = 0;
+static int rebalanced = 0;
+
+void zoningInit(void)
+{
+    pthread_mutex_lock(&zone_mutex);
+    memset(demand, 0, sizeof(demand));
+    calls_since_rebalance = 0;
+    rebalanced = 0;
+    pthread_mutex_unlock(&zone_mutex);
+}
+
+// floorLoad: what one floor adds to its sector's load. A trip to a higher floor keeps
+// the car longer, so demand counts by height above the lowest floor served.
+static double floorLoad(int floor, int lowest)
+{
+    return (demand[floor - STOP_MIN_FLOOR] + ZONE_BASELINE) * (floor - lowest + 1);
+}
+
+// coveredSectors: the sectors a car can serve every floor of, which are consecutive, as
+// *first to *last (*last < *first if none)
+static void coveredSectors(const Car *car, const int *sector_lo, const int *sector_hi, int sectors,
+                           int *first, int *last)
+{
+    // First sector starting at or above the car's lowest floor
+    int lo = 0, hi = sectors;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (sector_lo[mid] >= car->lowest_floor)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    *first = lo;
+
+    // Last sector ending at or below its highest floor
+    lo = -1, hi = sectors - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi + 1) / 2;
+        if (sector_hi[mid] <= car->highest_floor)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    *last = lo;
+}
+
+// rebalanceZones: split the served floors into sectors of equal load and give each car one.
+// Sectors are capped at ZONE_MAX_SECTORS and each car's covered sectors found once, so this is
+// O(cars * sectors) however big the fleet. Called with zone_mutex and the registry lock held.
+static void rebalanceZones(void)
+{
+    Car **cars = malloc((num_cars > 0 ? num_cars : 1) * sizeof(Car *));
+    int active = 0;
+    int lowest = STOP_MAX_FLOOR, highest = STOP_MIN_FLOOR;
+    for (int i = 0; i < num_cars; i++)
+    {
+        Car *car = connected_cars[i];
+        if (!car->is_active)
+            continue;
+        cars[active++] = car;
+        if (car->lowest_floor < lowest)
+            lowest = car->lowest_floor;
+        if (car->highest_floor > highest)
+            highest = car->highest_floor;
+    }
+    if (active == 0)
+    {
+        free(cars);
+        return;
+    }
+
+    // One sector per car, but never more sectors than floors
+    int sectors = active < highest - lowest + 1 ? active : highest - lowest + 1;
+    if (sectors > ZONE_MAX_SECTORS)
+        sectors = ZONE_MAX_SECTORS;
+    int *sector_lo = malloc(sectors * sizeof(int));
+    int *sector_hi = malloc(sectors * sizeof(int));
+    double *sector_load = calloc(sectors, sizeof(double));
+    int *sector_cars = calloc(sectors, sizeof(int));
+    int *choices = calloc(sectors + 1, sizeof(int)); // Free cars that can serve each sector
+    int *car_sector = malloc(active * sizeof(int));
+    int *car_first = malloc(active * sizeof(int));
+    int *car_last = malloc(active * sizeof(int));
+
+    double total = 0;
+    for (int f = lowest; f <= highest; f++)
+        total += floorLoad(f, lowest);
+
+    // Cut whenever the running load passes the next share, leaving a floor for each sector to come
+    int s = 0;
+    double running = 0;
+    sector_lo[0] = lowest;
+    for (int f = lowest; f <= highest; f++)
+    {
+        double load = floorLoad(f, lowest);
+        running += load;
+        sector_load[s] += load;
+        if (s < sectors - 1 && (running >= total * (s + 1) / sectors || highest - f == sectors - 1 - s))
+        {
+            sector_hi[s] = f;
+            sector_lo[++s] = f + 1;
+        }
+    }
+    sector_hi[sectors - 1] = highest;
+
+    // Count each sector's choices from the cars' covered sectors (a difference array)
+    for (int c = 0; c < active; c++)
+    {
+        car_sector[c] = -1;
+        coveredSectors(cars[c], sector_lo, sector_hi, sectors, &car_first[c], &car_last[c]);
+        if (car_first[c] <= car_last[c])
+        {
+            choices[car_first[c]]++;
+            choices[car_last[c] + 1]--;
+        }
+    }
+    for (int t = 1; t < sectors; t++)
+        choices[t] += choices[t - 1];
+
+    // First give every sector a car, starting with the sector fewest cars can serve, and
+    // picking the car that can serve fewest sectors
+    for (int round = 0; round < sectors; round++)
+    {
+        int pick = -1;
+        for (int t = 0; t < sectors; t++)
+        {
+            if (sector_cars[t] == 0 && choices[t] > 0 && (pick == -1 || choices[t] < choices[pick]))
+                pick = t;
+        }
+        if (pick == -1)
+            break; // The sectors left are beyond every free car's range
+
+        int best = -1, best_fits = 0;
+        for (int c = 0; c < active; c++)
+        {
+            if (car_sector[c] != -1 || pick < car_first[c] || pick > car_last[c])
+                continue;
+            int fits = car_last[c] - car_first[c] + 1;
+            if (best == -1 || fits < best_fits)
+            {
+                best = c;
+                best_fits = fits;
+            }
+        }
+        car_sector[best] = pick;
+        sector_cars[pick]++;
+        for (int t = car_first[best]; t <= car_last[best]; t++)
+            choices[t]--;
+    }
+
+    // Cars left over join the busiest sector they can serve, else the one they overlap most
+    for (int c = 0; c < active; c++)
+    {
+        if (car_sector[c] != -1)
+            continue;
+        int best = -1, best_covered = 0, best_overlap = 0;
+        double best_share = 0;
+        for (int t = 0; t < sectors; t++)
+        {
+            int covered = (t >= car_first[c] && t <= car_last[c]);
+            double share = sector_load[t] / (sector_cars[t] + 1);
+            int lo = sector_lo[t] > cars[c]->lowest_floor ? sector_lo[t] : cars[c]->lowest_floor;
+            int hi = sector_hi[t] < cars[c]->highest_floor ? sector_hi[t] : cars[c]->highest_floor;
+            int overlap = hi - lo + 1;
+            if (best == -1 || covered > best_covered ||
+                (covered == best_covered && (covered ? share > best_share : overlap > best_overlap)))
+            {
+                best = t;
+                best_covered = covered;
+                best_share = share;
+                best_overlap = overlap;
+            }
+        }
+        car_sector[c] = best;
+        sector_cars[best]++;
+    }
+
+    // A sector no car could take is shared by the cars next to it that can reach it
+    for (int c = 0; c < active; c++)
+    {
+        int t = car_sector[c];
+        int lo = sector_lo[t], hi = sector_hi[t];
+        for (int below = t - 1; below >= 0 && sector_cars[below] == 0; below--)
+            lo = sector_lo[below];
+        for (int above = t + 1; above < sectors && sector_cars[above] == 0; above++)
+            hi = sector_hi[above];
+
+        Car *car = cars[c];
+        lockCar(car);
+        car->zone_lowest = lo > car->lowest_floor ? lo : car->lowest_floor;
+        car->zone_highest = hi < car->highest_floor ? hi : car->highest_floor;
+        unlockCar(car);
+    }
+    logInfo("Rebalanced %d cars into %d zones\n", active, sectors);
+
+    free(cars);
+    free(sector_lo);
+    free(sector_hi);
+    free(sector_load);
+    free(sector_cars);
+    free(choices);
+    free(car_sector);
+    free(car_first);
+    free(car_last);
+}
+
+void zoningRecordCall(int source, int dest)
+{
+    int key = source > dest ? source : dest;
+    if (key < STOP_MIN_FLOOR || key > STOP_MAX_FLOOR)
+        return;
+
+    pthread_mutex_lock(&zone_mutex);
+    demand[key - STOP_MIN_FLOOR] += 1;
+    calls_since_rebalance++;
+
+    registryReadLock();
+    if (!rebalanced || calls_since_rebalance >= ZONE_REBALANCE_CALLS || seen_generation != registry_generation)
+    {
+        rebalanceZones();
+        rebalanced = 1;
+        seen_generation = registry_generation;
+        if (calls_since_rebalance >= ZONE_REBALANCE_CALLS)
+        {
+            for (int f = 0; f < STOP_FLOORS; f++)
+                demand[f] *= ZONE_DECAY;
+            calls_since_rebalance = 0;
+        }
+    }
+    registryUnlock();
+    pthread_mutex_unlock(&zone_mutex);
+}
+
+int zoningDistance(const Car *car, int source, int dest)
+{
+    int key = source > dest ? source : dest;
+    if (key > car->zone_highest)
+        return key - car->zone_highest;
+    if (key < car->zone_lowest)
+        return car->zone_lowest - key;
+    return 0;
+}
+
+void zoningDescribe(char *buf, size_t size)
+{
+    if (!__atomic_load_n(&zoning_enabled, __ATOMIC_RELAXED))
+    {
+        snprintf(buf, size, "ZONES disabled");
+        return;
+    }
+
+    size_t len = snprintf(buf, size, "ZONES");
+    registryReadLock();
+    for (int i = 0; i < num_cars; i++)
+    {
+        Car *car = connected_cars[i];
+        if (!car->is_active)
+            continue;
+        char lo[8], hi[8], entry[72];
+        lockCar(car);
+        int_to_floor(car->zone_lowest, lo);
+        int_to_floor(car->zone_highest, hi);
+        unlockCar(car);
+        int entry_len = snprintf(entry, sizeof(entry), " %s=%s-%s", car->name, lo, hi);
+        if (len + entry_len >= size)
+            break; // Only whole entries, as many as fit
+        memcpy(buf + len, entry, entry_len + 1);
+        len += entry_len;
+    }
+    registryUnlock();
+}
@@ -0,0 +1,44 @@
+#ifndef ZONING_H
+#define ZONING_H
+
+#include <stddef.h>
+#include "registry.h"
+
+// Dynamic zoning (--zones): in a tall building, keep each car to a sector of
+// floors so that only a few of them make full-height trips.
+//
+// Each call counts as demand at the highest floor of its trip, the furthest
+// up a car has to go to serve it. Every ZONE_REBALANCE_CALLS calls, and on
+// the first call after a car registers or disconnects, the floors the fleet
+// serves are split into one sector per car (at most 64, so a big
+// fleet shares them and rebalancing stays cheap), each carrying about the same
+// load (demand weighted by height, so sectors are thinner near the top).
+// Every car is then given a sector that lies within its registered range,
+// cars that fit the fewest sectors choosing first. A car's zone is its sector
+// (plus any neighbouring sector no car could take) clipped to its range, so a
+// car is never zoned to a floor it can't serve.
+//
+// Dispatch charges a busy car for each floor a call would take it outside its
+// zone; it is a cost, not a rule, so a car can still help out next door when
+// its neighbour is swamped, and an idle car goes wherever it is needed.
+// Demand halves at every rebalance, so the sectors follow the traffic as it
+// shifts.
+
+extern int zoning_enabled; // Set by --zones; switched by --adaptive, so accessed with __atomic
+
+// zoningInit: forget all demand, so the first call sets the zones afresh
+void zoningInit(void);
+
+// zoningRecordCall: count a call's demand and rebalance the zones if they are due.
+// Called without the registry lock held.
+void zoningRecordCall(int source, int dest);
+
+// zoningDistance: floors a call would take a car outside its zone, 0 if none.
+// Called with the car's lock held.
+int zoningDistance(const Car *car, int source, int dest);
+
+// zoningDescribe: "ZONES Alpha=1-10 Beta=11-20" (as many cars as fit in size) for the admin
+// tool, or "ZONES disabled"
+void zoningDescribe(char *buf, size_t size);
+
+#endif